@@ -0,0 +1,170 @@
+/*
+ * lunadisk - rows of the Moon's disk and its lit part
+ *
+ * Seen from the Earth the terminator is half an ellipse across the disk
+ * whose minor semi-axis is the disk's radius times -cos(phase angle), or
+ * 1 - 2 * illuminated fraction, measured towards the lit limb.  Each row
+ * of the disk is then lit from that ellipse to the bright limb: one span,
+ * found with a multiply from the row's half width, which is tabulated
+ * once per disk.
+ *
+ * luna_disk_shade() draws the Moon with no picture at all: a sphere lit
+ * by Lambert's law, its albedo a bright highland level, darkened inside
+ * a few ellipses placed like the larger maria and roughened by a hash
+ * of the pixel position.  All of it is integer arithmetic by rows; the
+ * sphere's depth along a row is followed outwards from the centre, so
+ * no square root is taken per pixel.
+ */
+
+#include "lunadisk.h"
+
+static int isqrt(int32_t n)
+{
+    int32_t x = 0, bit = 1L << 30;
+
+    while (bit > n) bit >>= 2;
+    while (bit)
+    {
+        if (n >= x + bit)
+        {
+            n -= x + bit;
+            x = (x >> 1) + bit;
+        }
+        else
+            x >>= 1;
+        bit >>= 2;
+    }
+    return (int) x;
+}
+
+void luna_disk_init(struct luna_disk *d, int cx, int cy, int r)
+{
+    int i;
+
+    if (r > LUNA_DISK_MAXR) r = LUNA_DISK_MAXR;
+    if (r < 0) r = 0;
+    d->cx = cx;
+    d->cy = cy;
+    d->r = r;
+    for (i = -r; i <= r; i++)
+        d->half[i + r] = (int16_t) isqrt((int32_t) r * r - (int32_t) i * i);
+}
+
+/*  illum from 0, new, to 1, full; waxing puts the lit limb on the right,
+    as seen from the northern hemisphere.  */
+void luna_light_init(struct luna_light *l, double illum, int waxing)
+{
+    if (illum < 0) illum = 0;
+    if (illum > 1) illum = 1;
+    l->k = (int32_t) ((1 - 2 * illum) * 16384 + (illum < 0.5 ? 0.5 : -0.5));
+    l->s = isqrt(16384 * 16384 - l->k * l->k);
+    l->waxing = waxing;
+}
+
+/*  Lit part of row y as the span [*x0, *x1); 0 if none of it is lit.  */
+int luna_disk_lit(const struct luna_disk *d, const struct luna_light *l, int y,
+                  int *x0, int *x1)
+{
+    int w, t;
+
+    if (y < d->cy - d->r || y > d->cy + d->r) return 0;
+    w = d->half[y - d->cy + d->r];
+    t = (int) ((w * l->k) / 16384);
+    if (l->waxing)
+    {
+        *x0 = d->cx + t;
+        *x1 = d->cx + w;
+    }
+    else
+    {
+        *x0 = d->cx - w;
+        *x1 = d->cx - t;
+    }
+    return *x1 > *x0;
+}
+
+/*  Maria, centre and semi-axes in 1/128 of the radius with north up and
+    east to the right, and the fraction of the highland albedo they
+    keep, /256  */
+static const struct mare {
+    int8_t x, y;
+    uint8_t a, b, keep;
+} maria[] = {
+    { -84,  -6, 34, 58, 150 },      /* Oceanus Procellarum */
+    { -42, -54, 36, 28, 140 },      /* Imbrium */
+    {  24, -50, 22, 20, 135 },      /* Serenitatis */
+    {  42, -12, 28, 22, 140 },      /* Tranquillitatis */
+    {  92, -36, 13, 11, 130 },      /* Crisium */
+    {  76,  18, 15, 22, 155 },      /* Fecunditatis */
+    {  50,  36, 11, 11, 160 },      /* Nectaris */
+    { -26,  44, 24, 18, 165 },      /* Nubium */
+    {   6, -30, 10,  8, 160 },      /* Vaporum */
+    {   0, -90, 60,  8, 175 },      /* Frigoris */
+};
+
+#define HIGHLAND    224
+
+/*  Row y of the disk shaded as at l into lum[0 .. *x1 - *x0), the row
+    starting at pixel *x0; 0 if y misses the disk.  The unlit part keeps
+    an eighth of its albedo, for earthshine, as in the hybrid renderer.  */
+int luna_disk_shade(const struct luna_disk *d, const struct luna_light *l, int y,
+                    uint8_t *lum, int *x0, int *x1)
+{
+    int r = d->r, w, v, i, dx, z, a, h, s;
+    int32_t inv, num, w2;
+    uint8_t *c;
+
+    if (r == 0 || y < d->cy - r || y > d->cy + r) return 0;
+    w = d->half[y - d->cy + r];
+    *x0 = d->cx - w;
+    *x1 = d->cx + w + 1;
+    c = lum + w;
+
+    for (dx = -w; dx <= w; dx++)
+    {
+        uint32_t u = (uint32_t) (dx + d->cx) * 73856093u ^ (uint32_t) y * 19349663u;
+
+        u = (u ^ u >> 15) * 0x2c1b3c6du;
+        h = (int) (u >> 27);
+        c[dx] = (uint8_t) (HIGHLAND - 16 + h);
+    }
+    v = (y - d->cy) * 128 / r;
+    for (i = 0; i < (int) (sizeof(maria) / sizeof(maria[0])); i++)
+    {
+        const struct mare *m = &maria[i];
+        int dy = v - m->y, half, mx, from, to;
+
+        if (dy <= -m->b || dy >= m->b) continue;
+        half = isqrt(m->b * m->b - dy * dy) * m->a / m->b * r / 128;
+        mx = m->x * r / 128;
+        from = mx - half < -w ? -w : mx - half;
+        to = mx + half > w ? w : mx + half;
+        for (dx = from; dx <= to; dx++)
+            c[dx] = (uint8_t) (c[dx] * m->keep >> 8);
+    }
+
+    /*  Lambert: cos incidence = (x s - z k) / r, x towards the sun  */
+    inv = 65536 / r;
+    s = l->waxing ? l->s : -l->s;
+    w2 = (int32_t) w * w;
+    for (dx = 0, z = w; dx <= w; dx++)
+    {
+        while (z > 0 && (int32_t) z * z > w2 - (int32_t) dx * dx) z--;
+        for (i = -1; i <= 1; i += 2)
+        {
+            num = i * dx * s - z * l->k;
+            a = c[i * dx];
+            if (num > 0)
+            {
+                num = (num * inv) >> 22;
+                a = a * (num > 256 ? 256 : num) >> 8;
+                if (a < c[i * dx] >> 3) a = c[i * dx] >> 3;
+            }
+            else
+                a >>= 3;
+            c[i * dx] = (uint8_t) a;
+            if (dx == 0) break;
+        }
+    }
+    return 1;
+}
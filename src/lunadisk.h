@@ -0,0 +1,30 @@
+/*  The Moon's disk on screen by rows, and the part of each row lit at a
+    given phase  */
+
+#ifndef LUNADISK_H
+#define LUNADISK_H
+
+#include <stdint.h>
+
+#define LUNA_DISK_MAXR  160
+
+struct luna_disk {
+    int cx, cy, r;                  /* centre and radius, pixels */
+    int16_t half[2 * LUNA_DISK_MAXR + 1];   /* half width of row cy - r + i */
+};
+
+struct luna_light {
+    int32_t k;                      /* terminator x over half width, Q14;
+                                       also -cos(phase angle) */
+    int32_t s;                      /* sin(phase angle), Q14 */
+    int waxing;                     /* lit limb on the right */
+};
+
+void luna_disk_init(struct luna_disk *d, int cx, int cy, int r);
+void luna_light_init(struct luna_light *l, double illum, int waxing);
+int luna_disk_lit(const struct luna_disk *d, const struct luna_light *l, int y,
+                  int *x0, int *x1);
+int luna_disk_shade(const struct luna_disk *d, const struct luna_light *l, int y,
+                    uint8_t *lum, int *x0, int *x1);
+
+#endif
@@ -0,0 +1,219 @@
+/*
+ * lunaframes - frame set lookup and the external data container
+ *
+ * Frames are kept in phase order with a table of nbucket uniform phase
+ * buckets, made fine enough by framegen that at most one boundary
+ * between nearest frames falls in each.  The frame nearest to a phase
+ * is then the one listed for its bucket or the one after it: two
+ * distance comparisons, whatever the number of frames.
+ *
+ * Frames not in JPEG are unpacked here, a span of pixels at a time,
+ * through a table from grey to the display's colours.  Delta coded
+ * frames are built up in a grey buffer kept by the caller, from their
+ * key frame or from the frame already there when it is on the way, so
+ * stepping to the next frame rewrites only the blocks that changed.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "lunaframes.h"
+
+/*  FNV-1a, 32 bits  */
+uint32_t luna_checksum(const unsigned char *p, size_t n)
+{
+    uint32_t h = 2166136261u;
+
+    while (n--) h = (h ^ *p++) * 16777619u;
+    return h;
+}
+
+/*  Index the container at p, size bytes, into f.  Returns 0, or -1 if it
+    is not a frame set of this version or fails its checks; frame data
+    is checked separately, by luna_frame_ok().  */
+int luna_frames_open(struct luna_frames *f, const void *p, size_t size)
+{
+    const struct luna_frames_file *h = p;
+    size_t index;
+    int i;
+
+    if (!p || ((uintptr_t) p & 3) || size < sizeof(*h) ||
+        h->magic != LUNA_FRAMES_MAGIC || h->version != LUNA_FRAMES_VERSION ||
+        h->header_size != sizeof(*h) || h->nframe == 0 || h->nbucket == 0 ||
+        (h->nbucket & (h->nbucket - 1)) != 0 || h->codec > LUNA_CODEC_DELTA)
+        return -1;
+    index = h->nframe * sizeof(struct luna_frame) + ((h->nbucket * sizeof(uint16_t) + 3) & ~3u);
+    if (size - sizeof(*h) < index || size - sizeof(*h) - index < h->data_len ||
+        luna_checksum((const unsigned char *) (h + 1), index) != h->index_checksum)
+        return -1;
+
+    f->nframe = h->nframe;
+    f->nbucket = h->nbucket;
+    f->tables_len = h->tables_len;
+    f->codec = h->codec;
+    f->frame = (const struct luna_frame *) (h + 1);
+    f->bucket = (const uint16_t *) (f->frame + f->nframe);
+    f->data = (const unsigned char *) (h + 1) + index;
+    if (f->tables_len > h->data_len) return -1;
+    for (i = 0; i < f->nframe; i++)
+        if (f->frame[i].offset > h->data_len ||
+            f->frame[i].length > h->data_len - f->frame[i].offset)
+            return -1;
+    for (i = 0; i < f->nbucket; i++)
+        if (f->bucket[i] >= f->nframe) return -1;
+    /* delta frames are decoded onto each other in one buffer */
+    if (f->codec == LUNA_CODEC_DELTA)
+        for (i = 1; i < f->nframe; i++)
+            if (f->frame[i].width != f->frame[0].width ||
+                f->frame[i].height != f->frame[0].height)
+                return -1;
+    return 0;
+}
+
+static inline double distance(double a, double b)
+{
+    double d = fabs(a - b);
+
+    return d > 0.5 ? 1 - d : d;
+}
+
+/*  Frame nearest to phase, going round from 1 to 0.  */
+int luna_frame_find(const struct luna_frames *f, double phase)
+{
+    int i, j;
+
+    if (phase < 0 || phase >= 1) phase -= floor(phase);
+    i = f->bucket[(int) (phase * f->nbucket) & (f->nbucket - 1)];
+    j = i + 1 == f->nframe ? 0 : i + 1;
+    return distance(phase, f->frame[j].phase) < distance(phase, f->frame[i].phase) ? j : i;
+}
+
+/*  Whether frame i's data has its checksum.  */
+int luna_frame_ok(const struct luna_frames *f, int i)
+{
+    return luna_checksum(f->data + f->frame[i].offset, f->frame[i].length) ==
+           f->frame[i].checksum;
+}
+
+void luna_unpack_init(struct luna_unpack *u, int codec, const unsigned char *p, size_t n)
+{
+    u->p = p;
+    u->end = p + n;
+    u->codec = codec;
+    u->run = 0;
+    u->value = 0;
+}
+
+/*  Read the next run or pixel of an RLE or QOI frame; 0 at the end.  */
+static inline int next_run(struct luna_unpack *u)
+{
+    int b;
+
+    if (u->p == u->end) return 0;
+    b = *u->p++;
+    u->run = 1;
+    if (u->codec == LUNA_CODEC_RLE)
+    {
+        u->value = (uint8_t) ((b >> 4) * 17);
+        u->run = (b & 15) + 1;
+    }
+    else if (b < 0x40)
+        u->run = b + 1;
+    else if (b < 0x80)
+        u->value = (uint8_t) (u->value + b - 0x60);
+    else if (u->p < u->end)
+        u->value = *u->p++;
+    else
+        return u->run = 0;
+    return 1;
+}
+
+/*  The next n pixels, as lut[grey], into out; returns how many there
+    were before the data ran out.  */
+int luna_unpack(struct luna_unpack *u, const uint16_t *lut, uint16_t *out, int n)
+{
+    int k = 0, m;
+    uint16_t c;
+
+    if (u->codec == LUNA_CODEC_RAW)
+    {
+        if (n > u->end - u->p) n = (int) (u->end - u->p);
+        while (k < n) out[k++] = lut[*u->p++];
+        return n;
+    }
+    while (k < n && (u->run || next_run(u)))
+    {
+        c = lut[u->value];
+        m = u->run < n - k ? u->run : n - k;
+        u->run -= m;
+        while (m--) out[k++] = c;
+    }
+    return k;
+}
+
+/*  n grey pixels of a QOI stream into dst; 0, or -1 if the data ran
+    out.  */
+static int unpack_grey(struct luna_unpack *u, uint8_t *dst, int n)
+{
+    int k = 0, m;
+
+    while (k < n && (u->run || next_run(u)))
+    {
+        m = u->run < n - k ? u->run : n - k;
+        u->run -= m;
+        memset(dst + k, u->value, m);
+        k += m;
+    }
+    return k == n ? 0 : -1;
+}
+
+/*  Decode delta coded frame j onto pix, which holds frame j - 1 unless
+    j is a key frame.  */
+static int apply_frame(const struct luna_frames *f, int j, uint8_t *pix)
+{
+    const struct luna_frame *fr = &f->frame[j];
+    const unsigned char *p = f->data + fr->offset, *bits = p + 1;
+    int w = fr->width, bw = w / 8, nblock = bw * (fr->height / 8), b, y;
+    struct luna_unpack u;
+    uint8_t block[64];
+
+    if (fr->length < 1) return -1;
+    if (*p == 0)
+    {
+        luna_unpack_init(&u, LUNA_CODEC_QOI, p + 1, fr->length - 1);
+        if (unpack_grey(&u, pix, w * fr->height)) return -1;
+    }
+    else
+    {
+        if (fr->length < 1 + (uint32_t) (nblock + 7) / 8) return -1;
+        luna_unpack_init(&u, LUNA_CODEC_QOI, bits + (nblock + 7) / 8,
+                         fr->length - 1 - (nblock + 7) / 8);
+        for (b = 0; b < nblock; b++)
+            if (bits[b >> 3] >> (b & 7) & 1)
+            {
+                if (unpack_grey(&u, block, 64)) return -1;
+                for (y = 0; y < 8; y++)
+                    memcpy(pix + ((b / bw) * 8 + y) * w + (b % bw) * 8, block + 8 * y, 8);
+            }
+    }
+    return u.p == u.end && u.run == 0 ? 0 : -1;
+}
+
+/*  Bring pix, width * height grey pixels holding frame *have of a delta
+    coded set, or anything if *have is -1, to frame i: by the deltas
+    after *have if it lies between i and the key frame before it, else
+    from that key frame.  Returns 0, or -1 with *have -1 if a frame on
+    the way fails its checksum or does not decode.  */
+int luna_frame_seek(const struct luna_frames *f, int i, uint8_t *pix, int *have)
+{
+    int k = i, j;
+
+    while (k > 0 && (f->frame[k].length == 0 || f->data[f->frame[k].offset] != 0)) k--;
+    for (j = *have >= k && *have <= i ? *have + 1 : k; j <= i; j++)
+        if (!luna_frame_ok(f, j) || apply_frame(f, j, pix))
+        {
+            *have = -1;
+            return -1;
+        }
+    *have = i;
+    return 0;
+}
@@ -0,0 +1,85 @@
+/*  Moon frames: JPEG data linked in from luna_jpeg.bin by lunajpeg.S and
+    indexed by lunaindex.c, or the same in an NWA external data container;
+    all are written by tools/framegen  */
+
+#ifndef LUNAFRAMES_H
+#define LUNAFRAMES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct luna_frame {
+    uint32_t offset, length;        /* JPEG data of the frame, bytes */
+    float phase;                    /* phase shown, 0 to 1 */
+    uint16_t width, height;         /* pixels, as in its SOF */
+    uint32_t checksum;              /* luna_checksum() of the data */
+};
+
+/*  Frame codings.  The others than JPEG are greyscale rows top down,
+    cheap enough to decode straight to the display by luna_unpack():
+    RAW is a byte a pixel; RLE bytes are 4 bit level << 4 | run - 1;
+    QOI bytes are 00rrrrrr, a run of r + 1 of the last grey, 01dddddd,
+    the last grey plus d - 32, or 0x80 followed by a grey.  The last
+    grey starts as 0.  DELTA frames start with a byte: 0 for a key frame,
+    QOI coded whole, or 1 for the frame before with some 8x8 blocks
+    replaced, followed by a bitmap of those blocks, in rows, least
+    significant bit first, and their pixels QOI coded, each block's 64
+    in rows.  Frame 0 is a key frame; see luna_frame_seek().  */
+#define LUNA_CODEC_JPEG     0
+#define LUNA_CODEC_RAW      1
+#define LUNA_CODEC_RLE      2
+#define LUNA_CODEC_QOI      3
+#define LUNA_CODEC_DELTA    4
+
+struct luna_frames {
+    int nframe;                     /* frames in phase order */
+    int nbucket;                    /* entries of bucket[], a power of 2 */
+    uint32_t tables_len;            /* JPEG tables shared by all frames at
+                                       the start of the data, 0 if every
+                                       frame is a whole JPEG file */
+    int codec;                      /* LUNA_CODEC_... */
+    const struct luna_frame *frame;
+    const uint16_t *bucket;         /* frame nearest to phase b / nbucket;
+                                       the nearest to any phase in
+                                       [b, b + 1) / nbucket is it or the
+                                       next one */
+    const unsigned char *data;
+};
+
+/*  Container, little endian and 4 byte aligned: this header, struct
+    luna_frame frame[nframe], uint16_t bucket[nbucket] and data_len
+    bytes of data.  index_checksum covers frame[] and bucket[].  */
+#define LUNA_FRAMES_MAGIC   0x464e554cu     /* "LUNF" */
+#define LUNA_FRAMES_VERSION 2
+
+struct luna_frames_file {
+    uint32_t magic;
+    uint16_t version, header_size;
+    uint16_t nframe, nbucket;
+    uint16_t codec, reserved;
+    uint32_t tables_len;
+    uint32_t data_len;
+    uint32_t index_checksum;
+};
+
+/*  Decoder state for the codings other than JPEG  */
+struct luna_unpack {
+    const unsigned char *p, *end;
+    int codec;
+    int run;                        /* pixels of value still to give */
+    uint8_t value;                  /* last grey */
+};
+
+extern const struct luna_frames luna_frames;
+extern const unsigned char luna_jpeg[];
+extern const unsigned char luna_jpeg_end[];
+
+uint32_t luna_checksum(const unsigned char *p, size_t n);
+int luna_frames_open(struct luna_frames *f, const void *p, size_t size);
+int luna_frame_find(const struct luna_frames *f, double phase);
+int luna_frame_ok(const struct luna_frames *f, int i);
+void luna_unpack_init(struct luna_unpack *u, int codec, const unsigned char *p, size_t n);
+int luna_unpack(struct luna_unpack *u, const uint16_t *lut, uint16_t *out, int n);
+int luna_frame_seek(const struct luna_frames *f, int i, uint8_t *pix, int *have);
+
+#endif
@@ -0,0 +1,79 @@
+/* Moon frame index, written by tools/framegen; do not edit */
+
+#include "lunaframes.h"
+
+static const struct luna_frame frame[59] = {
+  /* offset, length, phase, width, height, checksum */
+  {      0,  1098, 0.993898809f, 240, 240, 0x38bbce2c },
+  {   1098,  1112, 0.00913975202f, 240, 240, 0x90311fcf },
+  {   2210,  1134, 0.0243275892f, 240, 240, 0xdb579ecf },
+  {   3344,  1183, 0.0394718237f, 240, 240, 0x1f897710 },
+  {   4527,  1295, 0.054582525f, 240, 240, 0x05a5e9cf },
+  {   5822,  1373, 0.0696705356f, 240, 240, 0xa17beca4 },
+  {   7195,  1463, 0.0847477168f, 240, 240, 0x757a2ca7 },
+  {   8658,  1570, 0.0998272151f, 240, 240, 0x09df18b7 },
+  {  10228,  1669, 0.114923626f, 240, 240, 0x4b795305 },
+  {  11897,  1734, 0.130053237f, 240, 240, 0x8cfce9a8 },
+  {  13631,  1849, 0.145234123f, 240, 240, 0xc7ae4ad4 },
+  {  15480,  1940, 0.160486281f, 240, 240, 0xba72c334 },
+  {  17420,  2031, 0.175831601f, 240, 240, 0x5df10973 },
+  {  19451,  2143, 0.191293776f, 240, 240, 0xdc2411f5 },
+  {  21594,  2278, 0.206898168f, 240, 240, 0xa140c27a },
+  {  23872,  2429, 0.222671434f, 240, 240, 0xd289a554 },
+  {  26301,  2601, 0.238641128f, 240, 240, 0x9b398d3f },
+  {  28902,  2751, 0.25483501f, 240, 240, 0xbf29988d },
+  {  31653,  2898, 0.271280259f, 240, 240, 0x0250d947 },
+  {  34551,  3072, 0.28800258f, 240, 240, 0x2924dc5b },
+  {  37623,  3263, 0.305024922f, 240, 240, 0x9eb9265e },
+  {  40886,  3453, 0.322366178f, 240, 240, 0xb69e16b1 },
+  {  44339,  3649, 0.34003979f, 240, 240, 0x04bb80e6 },
+  {  47988,  3861, 0.358052343f, 240, 240, 0x9bfd69b2 },
+  {  51849,  3976, 0.37640214f, 240, 240, 0xa93daeb0 },
+  {  55825,  4188, 0.395078003f, 240, 240, 0x794cdb92 },
+  {  60013,  4370, 0.414058685f, 240, 240, 0x62cba39a },
+  {  64383,  4498, 0.433312416f, 240, 240, 0x28b80afd },
+  {  68881,  4625, 0.452797502f, 240, 240, 0x0c007aea },
+  {  73506,  4597, 0.472463101f, 240, 240, 0xba5f74d1 },
+  {  78103,  4690, 0.492251217f, 240, 240, 0xc9fbf4c8 },
+  {  82793,  4631, 0.512098849f, 240, 240, 0x3f5b941e },
+  {  87424,  4680, 0.531940937f, 240, 240, 0x6efd159e },
+  {  92104,  4599, 0.551712871f, 240, 240, 0x6ce53bca },
+  {  96703,  4529, 0.571353912f, 240, 240, 0xe346a125 },
+  { 101232,  4375, 0.590809226f, 240, 240, 0x32d7788d },
+  { 105607,  4187, 0.610032201f, 240, 240, 0x1516c474 },
+  { 109794,  3985, 0.628985584f, 240, 240, 0x5302ba96 },
+  { 113779,  3755, 0.647642314f, 240, 240, 0xcd929840 },
+  { 117534,  3563, 0.665985525f, 240, 240, 0xd1843865 },
+  { 121097,  3362, 0.684007645f, 240, 240, 0x1cb54c2e },
+  { 124459,  3151, 0.701709688f, 240, 240, 0xdea229c1 },
+  { 127610,  2952, 0.71909976f, 240, 240, 0xd9e6fde2 },
+  { 130562,  2734, 0.73619169f, 240, 240, 0x5aed35b5 },
+  { 133296,  2573, 0.753003538f, 240, 240, 0xa96d4987 },
+  { 135869,  2455, 0.769556344f, 240, 240, 0xf104d594 },
+  { 138324,  2263, 0.785872936f, 240, 240, 0x388b89ff },
+  { 140587,  2142, 0.80197686f, 240, 240, 0x57873a77 },
+  { 142729,  2013, 0.817891717f, 240, 240, 0x849412cc },
+  { 144742,  1889, 0.833640695f, 240, 240, 0x8e6804e9 },
+  { 146631,  1795, 0.849245846f, 240, 240, 0x05614588 },
+  { 148426,  1715, 0.864727974f, 240, 240, 0x10d3df67 },
+  { 150141,  1638, 0.88010639f, 240, 240, 0x1ab8bff8 },
+  { 151779,  1533, 0.895398974f, 240, 240, 0x8d3b97d1 },
+  { 153312,  1478, 0.910622001f, 240, 240, 0x2308c7b6 },
+  { 154790,  1413, 0.92579025f, 240, 240, 0xe76e6a1e },
+  { 156203,  1286, 0.940917253f, 240, 240, 0xca1415ac },
+  { 157489,  1211, 0.95601517f, 240, 240, 0x04ab86b8 },
+  { 158700,  1133, 0.971095383f, 240, 240, 0xd5e5fe72 }
+};
+
+static const uint16_t bucket[128] = {
+  0, 1, 1, 2, 2, 3, 3, 4, 5, 5, 6, 6, 7, 7, 8, 8,
+  9, 9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 14, 15, 15, 16, 16,
+  17, 17, 18, 18, 19, 19, 20, 20, 20, 21, 21, 22, 22, 23, 23, 23,
+  24, 24, 25, 25, 26, 26, 26, 27, 27, 28, 28, 28, 29, 29, 30, 30,
+  30, 31, 31, 32, 32, 32, 33, 33, 34, 34, 34, 35, 35, 36, 36, 36,
+  37, 37, 38, 38, 38, 39, 39, 40, 40, 41, 41, 42, 42, 42, 43, 43,
+  44, 44, 45, 45, 46, 46, 47, 47, 48, 48, 49, 49, 50, 50, 51, 51,
+  52, 52, 53, 53, 54, 54, 55, 55, 56, 56, 57, 57, 58, 58, 0, 0
+};
+
+const struct luna_frames luna_frames = { 59, 128, 0, LUNA_CODEC_JPEG, frame, bucket, luna_jpeg };
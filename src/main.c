@@ -24,17 +24,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include "luna_data.h"
+#include <math.h>
+#include "lunaframes.h"
+#include "lunadisk.h"
 #include "picojpeg.h"
 #include <time.h>
 #include "moontool.h"
+#include "moonrise.h"
+#include "moonsky.h"
+#include "mooncal.h"
 
 
 const char eadk_app_name[] __attribute__((section(".rodata.eadk_app_name"))) = "Luna";
 const uint32_t eadk_api_level  __attribute__((section(".rodata.eadk_api_level"))) = 0;
 
 #define NFIELD 5 // 0=hr, 1=min,2=day,3=month,4=yr
-const int utc_offset=0;
+const double utc_offset=0.; // hours, local time = UTC + utc_offset
+const struct observer observer={51.48, 0.}; // degrees north and east, for moonrise/set and the sky track
 
 void statuslinemsg(const char * msg) {
   uint16_t c=0xfda6;
@@ -43,32 +49,7 @@ void statuslinemsg(const char * msg) {
 }
 
 
-int get_frame_no(double phase,int nframe, float *frame_phase)
-{
-    int i,no;
-    float d,dd;
-
-    if (phase < 0) phase = 0.;
-    if (phase > 1) phase = 1.;
-
-    dd = 2.;
-    no = -1;
-    for (i = 0;i < nframe; i++)
-    {
-        d = phase-frame_phase[i];
-        if (d >= 0.5) d = d-1;
-        if (d < -0.5) d = d+1;
-        if (d < 0) d=-d;
-        if (d < dd) 
-        {
-            no = i;
-            dd = d;
-        } 
-    }
-    return no;
-}
-
-void show_data(struct tm* time)
+void show_data(double jd)
 {
     char buf[100];    
     static const char *desc[] = {
@@ -78,13 +59,13 @@ void show_data(struct tm* time)
         "Waning Crescent"
     };
     int iphase;
-    double phase,jd,cphase, aom, cdist, cangdia, csund, csuang;
-    double jdfull,jdnew;
+    double phase,cphase, aom, cdist, cangdia, csund, csuang;
+    double jdfull,jdnew,day_start;
     char phase_tendency;
-    struct tm utc, tmfull,tmnew;
+    struct tm tmfull,tmnew,tmrise,tmset;
+    struct moon_day today;
+    char rise[8],set[8];
 
-    utc=tm2utc(time,utc_offset);
-    jd=jtime(&utc);
     phase=moon_phase(jd, &cphase, &aom, &cdist, &cangdia, &csund, &csuang);
 
     eadk_display_push_rect_uniform((eadk_rect_t){0,18,EADK_SCREEN_WIDTH,EADK_SCREEN_HEIGHT-36}, 0x0);
@@ -95,11 +76,7 @@ void show_data(struct tm* time)
     int x=10;  
     int y=20;
     
-    sprintf(buf, "Julian date:");
-    eadk_display_draw_string(buf, (eadk_point_t){x, y}, true, 0xfda6, eadk_color_black);
-    y+=20;
-
-    sprintf(buf, "   %ld.%04ld",(long) jd, (long) (10000*(jd- (long) jd)));
+    sprintf(buf, "Julian date: %ld.%04ld",(long) jd, (long) (10000*(jd- (long) jd)));
     eadk_display_draw_string(buf, (eadk_point_t){x, y}, true, 0xfda6, eadk_color_black);
     y+=20;
 
@@ -121,20 +98,32 @@ void show_data(struct tm* time)
     eadk_display_draw_string(buf, (eadk_point_t){x, y}, true, 0xfda6, eadk_color_black);
     y+=20;
 
-    sprintf(buf, "Distance:");
+    sprintf(buf, "Distance: %ld km",(long)(cdist));
+    eadk_display_draw_string(buf, (eadk_point_t){x, y}, true, 0xfda6, eadk_color_black);
+    y+=20;
+
+    // rise and set during the local day containing jd
+    day_start=floor(jd+utc_offset/24.-0.5)+0.5-utc_offset/24.;
+    moon_riseset(&observer, day_start, 1, &today);
+    tmrise=timej(today.rise+utc_offset/24.);
+    tmset=timej(today.set+utc_offset/24.);
+
+    sprintf(buf, "Moonrise / set:");
     eadk_display_draw_string(buf, (eadk_point_t){x, y}, true, 0xfda6, eadk_color_black);
     y+=20;
 
-    sprintf(buf, "   %ld km",(long)(cdist));
+    if(today.rise<0) strcpy(rise,"--:--"); else sprintf(rise,"%02d:%02d",tmrise.tm_hour,tmrise.tm_min);
+    if(today.set<0) strcpy(set,"--:--"); else sprintf(set,"%02d:%02d",tmset.tm_hour,tmset.tm_min);
+    sprintf(buf, "   %s / %s (UTC)",rise,set);
     eadk_display_draw_string(buf, (eadk_point_t){x, y}, true, 0xfda6, eadk_color_black);
     y+=20;
 
 
 
-    jdfull=phase_search_forward(jd,0.5);  
-    jdnew=phase_search_forward(jd,1.0);  
-    tmfull=timej(jdfull+utc_offset/24);
-    tmnew=timej(jdnew+utc_offset/24);
+    jdfull=phase_search_cached(jd,0.5);  
+    jdnew=phase_search_cached(jd,1.0);  
+    tmfull=timej(jdfull+utc_offset/24.);
+    tmnew=timej(jdnew+utc_offset/24.);
 
     int ynew,yfull;
 
@@ -168,21 +157,266 @@ void show_data(struct tm* time)
             
 }
 
-int jpg_offset, jpg_end;
+// display colours of the 256 grey levels
+const eadk_color_t *grey_lut(void)
+{
+  static eadk_color_t lut[256];
+  static bool done;
+  int i;
+
+  if(!done)
+  {
+    done=true;
+    for(i=0;i<256;i++)
+      lut[i]=(((uint16_t)(eadk_color_red * i / 255.)) & eadk_color_red)+
+             (((uint16_t)(eadk_color_green * i / 255.)) & eadk_color_green)+
+             (((uint16_t)(eadk_color_blue * i / 255.)) & eadk_color_blue);
+  }
+  return lut;
+}
+
+#ifdef LUNA_RENDER_PROCEDURAL
+// the Moon drawn from its phase alone, see lunadisk.c: one span per row
+void show_pic(double jd)
+{
+  static struct luna_disk disk;
+  const eadk_color_t *lut=grey_lut();
+  struct luna_light light;
+  uint8_t lum[EADK_SCREEN_HEIGHT];
+  eadk_color_t span[EADK_SCREEN_HEIGHT];
+  double phase,cphase, aom, cdist, cangdia, csund, csuang;
+  int i, y, x0, x1;
+
+  eadk_display_push_rect_uniform((eadk_rect_t){0,0,EADK_SCREEN_WIDTH,EADK_SCREEN_HEIGHT}, 0x0);
+
+  phase=moon_phase(jd, &cphase, &aom, &cdist, &cangdia, &csund, &csuang);
+  if(disk.r==0)
+    luna_disk_init(&disk, EADK_SCREEN_WIDTH/2, EADK_SCREEN_HEIGHT/2, EADK_SCREEN_HEIGHT/2-5);
+  luna_light_init(&light, cphase, phase<0.5);
+  for(y=0;y<EADK_SCREEN_HEIGHT;y++)
+    if(luna_disk_shade(&disk, &light, y, lum, &x0, &x1))
+    {
+      for(i=0;i<x1-x0;i++) span[i]=lut[lum[i]];
+      eadk_display_push_rect((eadk_rect_t){x0,y,x1-x0,1},(const eadk_color_t *)span);
+    }
+}
+#else
+// the frame set to show, looked up on first use: external data if it was
+// installed with the app, else the frames linked in (NULL without them)
+const struct luna_frames *get_frames(void)
+{
+  static struct luna_frames ext;
+  static const struct luna_frames *frames;
+  static bool looked;
+
+  if(!looked)
+  {
+    looked=true;
+    if(luna_frames_open(&ext, eadk_external_data, eadk_external_data_size)==0) frames=&ext;
+#ifndef LUNA_FRAMES_EXTERNAL
+    else frames=&luna_frames;
+#endif
+  }
+  return frames;
+}
+
+const unsigned char *jpg_data;
+int jpg_tables_offset, jpg_tables_end, jpg_offset, jpg_end;
 
 unsigned char pjpeg_need_bytes_callback(unsigned char* pBuf, unsigned char buf_size, unsigned char *pBytes_actually_read, void *pCallback_data)
 {
    unsigned int n;
+   int *offset=&jpg_offset, end=jpg_end;
    
+   // abbreviated frames: the shared tables go first
+   if(jpg_tables_offset < jpg_tables_end)
+   {
+     offset=&jpg_tables_offset;
+     end=jpg_tables_end;
+   }
    n=buf_size;
-   if(n>jpg_end - jpg_offset)n=jpg_end - jpg_offset;   
-   memcpy( (void*) pBuf, (void*) Luna_dat+jpg_offset, n);
+   if(n>end - *offset)n=end - *offset;   
+   memcpy( (void*) pBuf, (void*) jpg_data+*offset, n);
    *pBytes_actually_read = (unsigned char)(n);
-   jpg_offset += n;
+   *offset += n;
    return 0;
 }
 
-void show_pic(struct tm* time)
+// feed frame i of f to the next pjpeg_decode_init()
+void jpg_source(const struct luna_frames *f, int i)
+{
+  jpg_data=f->data;
+  jpg_tables_offset=0;
+  jpg_tables_end=f->tables_len;
+  jpg_offset=f->frame[i].offset;
+  jpg_end=jpg_offset+f->frame[i].length;
+}
+
+// draw frame i of f, coded other than in JPEG, eight rows at a time
+void show_unpacked(const struct luna_frames *f, int i)
+{
+  struct luna_unpack u;
+  eadk_color_t *band;
+  int w=f->frame[i].width, h=f->frame[i].height, y, n;
+
+  band=(eadk_color_t *) malloc(8*w*sizeof(eadk_color_t));
+  if(band==NULL) return;
+  luna_unpack_init(&u, f->codec, f->data+f->frame[i].offset, f->frame[i].length);
+  for(y=0;y<h;y+=8)
+  {
+    n=h-y<8 ? h-y : 8;
+    if(luna_unpack(&u, grey_lut(), band, n*w)!=n*w) break;
+    eadk_display_push_rect((eadk_rect_t){(EADK_SCREEN_WIDTH-w)/2,(EADK_SCREEN_HEIGHT-h)/2+y,w,n},(const eadk_color_t *)band);
+  }
+  free((void*)band);
+}
+
+// draw frame i of a delta coded set, built on the frame drawn last time:
+// stepping forwards between key frames decodes only the changed blocks
+void show_delta(const struct luna_frames *f, int i)
+{
+  static const struct luna_frames *set;
+  static uint8_t *pix;
+  static int have=-1;
+  const eadk_color_t *lut=grey_lut();
+  eadk_color_t *band;
+  int w=f->frame[i].width, h=f->frame[i].height, x, y, n;
+
+  if(set!=f || pix==NULL)
+  {
+    free(pix);
+    pix=(uint8_t *) malloc((size_t)w*h);
+    set=f;
+    have=-1;
+    if(pix==NULL) return;
+  }
+  if(luna_frame_seek(f,i,pix,&have)) return;
+  band=(eadk_color_t *) malloc(8*w*sizeof(eadk_color_t));
+  if(band==NULL) return;
+  for(y=0;y<h;y+=8)
+  {
+    n=h-y<8 ? h-y : 8;
+    for(x=0;x<n*w;x++) band[x]=lut[pix[y*w+x]];
+    eadk_display_push_rect((eadk_rect_t){(EADK_SCREEN_WIDTH-w)/2,(EADK_SCREEN_HEIGHT-h)/2+y,w,n},(const eadk_color_t *)band);
+  }
+  free((void*)band);
+}
+
+#ifdef LUNA_RENDER_HYBRID
+// The full moon decoded once into grey levels; every phase is drawn from
+// it, lit from the terminator to the bright limb and at an eighth of its
+// brightness elsewhere, as the dark side shows in the frames
+uint8_t *moon_tex;
+int moon_w, moon_h;
+struct luna_disk moon_disk;
+
+// decode the frame nearest the full moon into moon_tex and find its disk;
+// 0 if it cannot be had
+int moon_tex_load(const struct luna_frames *f)
+{
+  pjpeg_image_info_t info;
+  int i=luna_frame_find(f,0.5), mx, my, bx, by, x, y;
+  int x0, x1, y0, y1;
+
+  moon_w=f->frame[i].width;
+  moon_h=f->frame[i].height;
+  if(!luna_frame_ok(f,i)) return 0;
+  moon_tex=(uint8_t *) malloc((size_t)moon_w*moon_h);
+  if(moon_tex==NULL) return 0;
+  if(f->codec==LUNA_CODEC_DELTA)
+  {
+    int have=-1;
+
+    if(luna_frame_seek(f,i,moon_tex,&have)) goto fail;
+  }
+  else if(f->codec!=LUNA_CODEC_JPEG)
+  {
+    // unpacked through a table that leaves the grey levels as they are
+    uint16_t grey[256], buf[64];
+    struct luna_unpack u;
+    int k, n=moon_w*moon_h;
+
+    for(k=0;k<256;k++) grey[k]=k;
+    luna_unpack_init(&u, f->codec, f->data+f->frame[i].offset, f->frame[i].length);
+    for(k=0;k<n;k+=64)
+    {
+      x=n-k<64 ? n-k : 64;
+      if(luna_unpack(&u, grey, buf, x)!=x) goto fail;
+      for(y=0;y<x;y++) moon_tex[k+y]=(uint8_t)buf[y];
+    }
+  }
+  else
+  {
+    jpg_source(f,i);
+    if(pjpeg_decode_init(&info, pjpeg_need_bytes_callback, NULL, 0) ||
+       info.m_width!=moon_w || info.m_height!=moon_h || info.m_comps!=1)
+      goto fail;
+    for(my=0;my<info.m_MCUSPerCol;my++)
+      for(mx=0;mx<info.m_MCUSPerRow;mx++)
+      {
+        if(pjpeg_decode_mcu()) goto fail;
+        for(by=0;by<8 && 8*my+by<moon_h;by++)
+          for(bx=0;bx<8 && 8*mx+bx<moon_w;bx++)
+            moon_tex[(8*my+by)*moon_w+8*mx+bx]=info.m_pMCUBufR[8*by+bx];
+      }
+  }
+
+  // the disk is the box round everything brighter than the sky
+  x0=moon_w; x1=-1; y0=moon_h; y1=-1;
+  for(y=0;y<moon_h;y++)
+    for(x=0;x<moon_w;x++)
+      if(moon_tex[y*moon_w+x]>32)
+      {
+        if(x<x0) x0=x;
+        if(x>x1) x1=x;
+        if(y<y0) y0=y;
+        if(y>y1) y1=y;
+      }
+  if(x1<0) goto fail;
+  luna_disk_init(&moon_disk, (x0+x1+1)/2, (y0+y1+1)/2,
+                 (x1-x0 > y1-y0 ? x1-x0+1 : y1-y0+1)/2);
+  return 1;
+
+fail:
+  free(moon_tex);
+  moon_tex=NULL;
+  return 0;
+}
+
+// draw the cached full moon lit as at illum, eight rows at a time
+void show_shaded(double illum, int waxing)
+{
+  struct luna_light light;
+  const eadk_color_t *lut=grey_lut();
+  eadk_color_t *band;
+  const uint8_t *t;
+  int ox=(EADK_SCREEN_WIDTH-moon_w)/2, oy=(EADK_SCREEN_HEIGHT-moon_h)/2;
+  int x, y, yb, x0, x1;
+
+  band=(eadk_color_t *) malloc(8*moon_w*sizeof(eadk_color_t));
+  if(band==NULL) return;
+  luna_light_init(&light, illum, waxing);
+  for(yb=0;yb<moon_h;yb+=8)
+  {
+    for(y=yb;y<yb+8 && y<moon_h;y++)
+    {
+      eadk_color_t *row=band+(y-yb)*moon_w;
+      t=moon_tex+y*moon_w;
+      for(x=0;x<moon_w;x++) row[x]=lut[t[x]>>3];
+      if(luna_disk_lit(&moon_disk, &light, y, &x0, &x1))
+      {
+        if(x0<0) x0=0;
+        if(x1>moon_w) x1=moon_w;
+        for(x=x0;x<x1;x++) row[x]=lut[t[x]];
+      }
+    }
+    eadk_display_push_rect((eadk_rect_t){ox,oy+yb,moon_w,y-yb},(const eadk_color_t *)band);
+  }
+  free((void*)band);
+}
+#endif
+
+void show_pic(double jd)
 {
   pjpeg_image_info_t image_info;
   eadk_color_t *pixels;
@@ -190,18 +424,46 @@ void show_pic(struct tm* time)
   pixels=(eadk_color_t *) malloc(64);
 
   unsigned char status;
-  double phase,jd,cphase, aom, cdist, cangdia, csund, csuang;
-  struct tm utc;
+  double phase,cphase, aom, cdist, cangdia, csund, csuang;
 
   eadk_display_push_rect_uniform((eadk_rect_t){0,0,EADK_SCREEN_WIDTH,EADK_SCREEN_HEIGHT}, 0x0);
 
-  utc=tm2utc(time,utc_offset);
-  jd=jtime(&utc);
   phase=moon_phase(jd, &cphase, &aom, &cdist, &cangdia, &csund, &csuang);
   
-  int iphase=get_frame_no(phase,nframe,frame_phases);
-  jpg_offset=offsets[iphase];
-  jpg_end=offsets[iphase+1];
+  const struct luna_frames *frames=get_frames();
+  if(frames==NULL)
+  {
+    eadk_display_draw_string("Install Luna with its frame data", (eadk_point_t){10, 110}, true, 0xfda6, eadk_color_black);
+    free((void*)pixels);
+    return;
+  }
+#ifdef LUNA_RENDER_HYBRID
+  free((void*)pixels);
+  if(moon_tex==NULL && !moon_tex_load(frames))
+  {
+    eadk_display_draw_string("Moon picture cannot be loaded", (eadk_point_t){10, 110}, true, 0xfda6, eadk_color_black);
+    return;
+  }
+  show_shaded(cphase, phase<0.5);
+  return;
+#endif
+  int iphase=luna_frame_find(frames,phase);
+  if(!luna_frame_ok(frames,iphase))
+  {
+    eadk_display_draw_string("Moon frame data is damaged", (eadk_point_t){10, 110}, true, 0xfda6, eadk_color_black);
+    free((void*)pixels);
+    return;
+  }
+  if(frames->codec!=LUNA_CODEC_JPEG)
+  {
+    free((void*)pixels);
+    if(frames->codec==LUNA_CODEC_DELTA)
+      show_delta(frames,iphase);
+    else
+      show_unpacked(frames,iphase);
+    return;
+  }
+  jpg_source(frames,iphase);
   
   status = pjpeg_decode_init(&image_info, pjpeg_need_bytes_callback, NULL, 0);
   
@@ -236,8 +498,8 @@ void show_pic(struct tm* time)
       return;
     }
 
-    x=8*mcu_x+40;
-    y=8*mcu_y;
+    x=8*mcu_x+(EADK_SCREEN_WIDTH-image_info.m_width)/2;
+    y=8*mcu_y+(EADK_SCREEN_HEIGHT-image_info.m_height)/2;
     for(int i=0;i<64;i++)
     {
       c=image_info.m_pMCUBufR[i];
@@ -257,18 +519,70 @@ void show_pic(struct tm* time)
 
 }
 
-void show_date(struct tm* time, int field)
+#endif
+
+// altitude of the Moon from 12 hours before to 12 hours after jd, one
+// sample per screen column, with the horizon and the current time marked
+void show_track(double jd)
+{
+  static double alt[EADK_SCREEN_WIDTH];
+  struct moon_sky sky;
+  int i, y;
+
+  moon_sky_init(&sky, &observer);
+  moon_sky_track(&sky, jd-0.5, 1./EADK_SCREEN_WIDTH, EADK_SCREEN_WIDTH, alt, NULL);
+
+  eadk_display_push_rect_uniform((eadk_rect_t){0,18,EADK_SCREEN_WIDTH,EADK_SCREEN_HEIGHT-36}, 0x0);
+  eadk_display_push_rect_uniform((eadk_rect_t){0,120,EADK_SCREEN_WIDTH,1}, 0x7bef);
+  eadk_display_push_rect_uniform((eadk_rect_t){EADK_SCREEN_WIDTH/2,20,1,200}, 0x7bef);
+  for(i=0;i<EADK_SCREEN_WIDTH;i++)
+  {
+    y=120-(int)(alt[i]*100/90);
+    eadk_display_push_rect_uniform((eadk_rect_t){i,y-1,1,2}, alt[i]>0 ? 0xfda6 : 0x7bef);
+  }
+  eadk_display_draw_string("Altitude -12h..+12h", (eadk_point_t){10, 22}, false, 0xfda6, eadk_color_black);
+}
+
+// Islamic, Hebrew and Chinese dates of the local day containing jd
+void lunar_dates(double jd, char *msg)
 {
-  char buf[10];
+  static const char *islamic[] = {
+    "Muh", "Saf", "Rab I", "Rab II", "Jum I", "Jum II",
+    "Raj", "Sha", "Ram", "Shaw", "Dhu Q", "Dhu H"
+  };
+  static const char *hebrew[] = {
+    "Nisan", "Iyyar", "Sivan", "Tammuz", "Av", "Elul", "Tishri",
+    "Heshvan", "Kislev", "Tevet", "Shevat", "Adar", "Adar II"
+  };
+  static struct newmoon moons[32];
+  static struct newmoons table;
+  struct lunar_date isl, heb, chi;
+  int64_t day=(int64_t)floor(jd+utc_offset/24.-2440587.5);
+
+  if(table.m==NULL) newmoons_init(&table, moons, 32, jd);
+  islamic_from_days(&table, day, &isl);
+  hebrew_from_days(day, &heb);
+  chinese_from_days(&table, day, &chi);
+  sprintf(msg, "%d %s %d  %d %s%s %d  %s%d/%d",
+    isl.day, islamic[isl.month-1], isl.year,
+    heb.day, hebrew[heb.month-1], heb.month==12 && heb.leap ? " I" : "", heb.year,
+    chi.leap ? "L" : "", chi.month, chi.day);
+}
+
+void show_date(double jd, int field)
+{
+  char buf[10], msg[64];
+  struct tm local=timej(jd+utc_offset/24.);
   int c[NFIELD]={eadk_color_black};
   c[field]=0xfda6;
 
-  statuslinemsg("LUNA");
+  lunar_dates(jd, msg);
+  statuslinemsg(msg);
   eadk_display_push_rect_uniform((eadk_rect_t){0,EADK_SCREEN_HEIGHT-18,EADK_SCREEN_WIDTH,18}, 0x0);
 
 
   int x=50;  
-  sprintf(buf, "%02d",time->tm_hour);
+  sprintf(buf, "%02d",local.tm_hour);
   eadk_display_draw_string(buf, (eadk_point_t){x, 222}, true, eadk_color_white, c[0]);
   x+=10*strlen(buf);
   
@@ -276,7 +590,7 @@ void show_date(struct tm* time, int field)
   eadk_display_draw_string(buf, (eadk_point_t){x, 222}, true, eadk_color_white, eadk_color_black);
   x+=10*strlen(buf);
 
-  sprintf(buf, "%02d",time->tm_min);
+  sprintf(buf, "%02d",local.tm_min);
   eadk_display_draw_string(buf, (eadk_point_t){x, 222}, true, eadk_color_white, c[1]);
   x+=10*strlen(buf);
 
@@ -284,7 +598,7 @@ void show_date(struct tm* time, int field)
   eadk_display_draw_string(buf, (eadk_point_t){x, 222}, true, eadk_color_white, eadk_color_black);
   x+=10*strlen(buf);
 
-  sprintf(buf, "%02d",time->tm_mday);  
+  sprintf(buf, "%02d",local.tm_mday);  
   eadk_display_draw_string(buf, (eadk_point_t){x, 222}, true, eadk_color_white, c[2]);
   x+=10*strlen(buf);
 
@@ -292,7 +606,7 @@ void show_date(struct tm* time, int field)
   eadk_display_draw_string(buf, (eadk_point_t){x, 222}, true, eadk_color_white, eadk_color_black);
   x+=10*strlen(buf);
 
-  sprintf(buf, "%02d",time->tm_mon+1);
+  sprintf(buf, "%02d",local.tm_mon+1);
   eadk_display_draw_string(buf, (eadk_point_t){x, 222}, true, eadk_color_white, c[3]);
   x+=10*strlen(buf);
 
@@ -300,7 +614,7 @@ void show_date(struct tm* time, int field)
   eadk_display_draw_string(buf, (eadk_point_t){x, 222}, true, eadk_color_white, eadk_color_black);
   x+=10*strlen(buf);
 
-  sprintf(buf, "%04d",time->tm_year+1900);
+  sprintf(buf, "%04d",local.tm_year+1900);
   eadk_display_draw_string(buf, (eadk_point_t){x, 222}, true, eadk_color_white, c[4]);
   x+=10*strlen(buf);
 
@@ -315,40 +629,46 @@ int new_active_field(eadk_event_t ev, int field)
   return field;
 }
 
-void update_time(eadk_event_t ev, struct tm* time, int field)
+// hours, minutes and days step the Julian date directly; months and years
+// go through the local calendar fields so the day of month is kept
+void update_time(eadk_event_t ev, double* jd, int field)
 {
   int incr;
+  struct tm local;
   if(ev==eadk_event_up) incr=1;
   if(ev==eadk_event_down ) incr=-1;
   switch(field)
   {
     case 0:
-      time->tm_hour+=incr;
+      *jd+=incr/24.;
       break;
     case 1:
-      time->tm_min+=incr;
+      *jd+=incr/(24.*60.);
       break;
     case 2:
-      time->tm_mday+=incr;
+      *jd+=incr;
       break;
     case 3:
-      time->tm_mon+=incr;
-      break;
     case 4:
-      time->tm_year+=incr;
+      local=timej(*jd+utc_offset/24.);
+      if(field==3)
+        local.tm_mon+=incr;
+      else
+        local.tm_year+=incr;
+      *jd=jtime(&local)-utc_offset/24.;
       break;
   }
-  mktime(time);
 }
 
 void mainloop() {
-  struct tm time={.tm_year=2023-1900, .tm_mday=1};
-  int mode=0; //mode=0-> show data, 1-> show pic
+  struct tm start={.tm_year=2023-1900, .tm_mday=1};
+  double jd=jtime(&start)-utc_offset/24.; // UTC Julian date
+  int mode=0; //mode=0-> show data, 1-> show pic, 2-> show sky track
   int update=0;
   int current_field=0; 
 
-  show_date(&time,current_field);
-  show_data(&time);
+  show_date(jd,current_field);
+  show_data(jd);
   while (true) {
     int32_t timeout=1000;
     eadk_event_t ev=eadk_event_get(&timeout);
@@ -357,35 +677,40 @@ void mainloop() {
     {
       current_field=new_active_field(ev, current_field);
       if (mode==1) 
+      {
         update=1;
+        mode=0;
+      }
       else
-        show_date(&time,current_field);
-      mode=0;
+        show_date(jd,current_field);
     }
     
     if(ev==eadk_event_up || ev==eadk_event_down )
     {
-      update_time(ev, &time, current_field);
-      mode=0;
+      update_time(ev, &jd, current_field);
+      if(mode==1) mode=0;
       update=1;
     }
     
     if(ev==eadk_event_ok) 
     {
-      mode=1-mode;
+      mode=(mode+1)%3;
       update=1;
     }
     
     if(update)
     {
-      if(mode) 
+      if(mode==1) 
       {
-        show_pic(&time);
+        show_pic(jd);
       }
       else
       {
-        show_date(&time,current_field);
-        show_data(&time);
+        show_date(jd,current_field);
+        if(mode==2)
+          show_track(jd);
+        else
+          show_data(jd);
       }
       update=0;
     }
@@ -0,0 +1,280 @@
+/*
+ * mooncal - Islamic, Hebrew and Chinese calendar dates
+ *
+ * The Islamic and Chinese months begin with the new moon, so converting
+ * a date needs the new moons around it, and the Chinese calendar also
+ * the major solar terms at each month start.  Both are kept in a
+ * struct newmoons, a window of lunations indexed by lunation number and
+ * filled on demand, so after the first use of a lunation every lookup
+ * is an index.  The lunation holding a date is estimated from the mean
+ * synodic month and corrected by at most one step, so a conversion is a
+ * fixed number of table lookups.  The Hebrew calendar is arithmetic and
+ * needs no astronomy at all.
+ *
+ * Days are counted from 1970 January 1, as by days_from_civil().
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "moontool.h"
+#include "moonconst.h"
+#include "mooncal.h"
+
+#define UNIXEPOCH   2440587.5       /* 1970 January 1.0 */
+#define BROWN1      2423436.6115    /* new moon of Brown lunation 1 */
+
+/* -------------------------------------------------------------------- */
+/*  New moon window                                                     */
+
+/*  NEWMOONS_INIT  --  Use the size entries of buf as a window of new
+        moons centred on Julian date jd.  */
+void newmoons_init(struct newmoons *t, struct newmoon *buf, int size, double jd)
+{
+    t->m = buf;
+    t->size = size;
+    t->k0 = (long) floor((jd - BROWN1) / SYNMONTH) + 1 - size / 2;
+    t->searches = 0;
+    memset(buf, 0, size * sizeof(*buf));
+}
+
+static struct newmoon *entry(struct newmoons *t, long k)
+{
+    struct newmoon *e;
+
+    if (k < t->k0 || k >= t->k0 + t->size)
+    {
+        /* recentre on k; only a date far from the last ones gets here */
+        t->k0 = k - t->size / 2;
+        memset(t->m, 0, t->size * sizeof(*t->m));
+    }
+    e = &t->m[k - t->k0];
+    if (e->jd == 0)
+    {
+        /* the true new moon is within a day of the mean one */
+        t->searches++;
+        e->jd = phase_search_forward(BROWN1 + (k - 1) * SYNMONTH - 2, 1.0);
+    }
+    return e;
+}
+
+/*  NEWMOON  --  Julian date (UT) of the new moon starting lunation k.  */
+double newmoon(struct newmoons *t, long k)
+{
+    return entry(t, k)->jd;
+}
+
+/*  LUNATION  --  Number of the lunation in progress at Julian date jd.  */
+long lunation(struct newmoons *t, double jd)
+{
+    long k = (long) floor((jd - BROWN1) / SYNMONTH) + 1;
+
+    while (newmoon(t, k) > jd) k--;
+    while (newmoon(t, k + 1) <= jd) k++;
+    return k;
+}
+
+/*  Day on which lunation k begins in a calendar whose months start
+    after days days from the day of the new moon in a zone hours east.  */
+static int64_t month_start(struct newmoons *t, long k, double zone, int after)
+{
+    return (int64_t) floor(newmoon(t, k) + zone / 24 - UNIXEPOCH) + after;
+}
+
+/*  The lunation whose month contains day.  */
+static long month_of(struct newmoons *t, int64_t day, double zone, int after)
+{
+    long k = (long) floor((UNIXEPOCH + day - BROWN1) / SYNMONTH) + 1;
+
+    while (month_start(t, k, zone, after) > day) k--;
+    while (month_start(t, k + 1, zone, after) <= day) k++;
+    return k;
+}
+
+/* -------------------------------------------------------------------- */
+/*  Islamic                                                             */
+
+/* An astronomical rather than observed calendar, after the Umm al-Qura
+   rule: a month begins on the day after the conjunction if that falls
+   before sunset at Mecca, taken as 18h local time, and a day later if
+   not.  Counting the day in a zone six hours further east than Mecca
+   does just that.  The rule's second condition, moonset after sunset, is
+   not checked, so a month can start a day earlier than Umm al-Qura. */
+#define MECCA       (3.0 + 6.0)     /* hours east of Greenwich, plus 6 */
+#define HIJRA       (-16084)        /* lunation number of 1 Muharram 1 AH */
+
+void islamic_from_days(struct newmoons *t, int64_t day, struct lunar_date *d)
+{
+    long k = month_of(t, day, MECCA, 1), m = k - HIJRA;
+    long y = m >= 0 ? m / 12 : -((-m + 11) / 12);
+
+    d->year = (int) y + 1;
+    d->month = (int) (m - 12 * y) + 1;
+    d->day = (int) (day - month_start(t, k, MECCA, 1)) + 1;
+    d->leap = 0;
+}
+
+/* -------------------------------------------------------------------- */
+/*  Hebrew                                                              */
+
+/* The arithmetic calendar as in Reingold and Dershowitz, Calendrical
+   Calculations, with months counted from Nisan. */
+#define HEBREW_EPOCH    (-2092590)  /* 1 Tishri AM 1, days from 1970 */
+
+/*  Days from the epoch to the molad of Tishri of year y, postponed.  */
+static int64_t hebrew_elapsed(long y)
+{
+    int64_t months = (235 * (int64_t) y - 234) / 19;
+    int64_t parts = 12084 + 13753 * months;
+    int64_t days = 29 * months + parts / 25920;
+
+    return (3 * (days + 1)) % 7 < 3 ? days + 1 : days;
+}
+
+static int64_t hebrew_new_year(long y)
+{
+    int64_t ny0 = hebrew_elapsed(y - 1), ny1 = hebrew_elapsed(y),
+            ny2 = hebrew_elapsed(y + 1);
+    int delay = ny2 - ny1 == 356 ? 2 : ny1 - ny0 == 382 ? 1 : 0;
+
+    return HEBREW_EPOCH + ny1 + delay;
+}
+
+/*  Length of month m in a year of len days.  */
+static int hebrew_month_length(int m, int len)
+{
+    if (m == 2 || m == 4 || m == 6 || m == 10 || m == 13) return 29;
+    if (m == 12 && len < 380) return 29;            /* Adar of a common year */
+    if (m == 8 && len % 10 != 5) return 29;         /* short Heshvan */
+    if (m == 9 && len % 10 == 3) return 29;         /* short Kislev */
+    return 30;
+}
+
+/*  First day of month of a year starting on new_year and len days long.  */
+static int64_t hebrew_month_start(int64_t new_year, int len, int month)
+{
+    int64_t n = new_year;
+    int last = len > 380 ? 13 : 12, m;
+
+    if (month < 7)
+    {
+        for (m = 7; m <= last; m++) n += hebrew_month_length(m, len);
+        for (m = 1; m < month; m++) n += hebrew_month_length(m, len);
+    } else
+    {
+        for (m = 7; m < month; m++) n += hebrew_month_length(m, len);
+    }
+    return n;
+}
+
+/*  DAYS_FROM_HEBREW  --  Day number of a Hebrew date.  */
+int64_t days_from_hebrew(int year, int month, int day)
+{
+    int64_t ny = hebrew_new_year(year);
+
+    return hebrew_month_start(ny, (int) (hebrew_new_year(year + 1) - ny), month) +
+           day - 1;
+}
+
+void hebrew_from_days(int64_t day, struct lunar_date *d)
+{
+    /* mean year of 35975351/98496 days */
+    long y = (long) floor((day - HEBREW_EPOCH) * (98496.0 / 35975351.0)) + 1;
+    int64_t ny = hebrew_new_year(y), next = hebrew_new_year(y + 1), start;
+    int m, len;
+
+    if (ny > day)
+    {
+        next = ny;
+        ny = hebrew_new_year(--y);
+    } else if (next <= day)
+    {
+        ny = next;
+        next = hebrew_new_year(++y + 1);
+    }
+    len = (int) (next - ny);
+
+    /* from Tishri (7) through Adar, or from Nisan (1) through Elul */
+    start = hebrew_month_start(ny, len, 1);
+    if (day >= start)
+        m = 1;
+    else
+    {
+        m = 7;
+        start = ny;
+    }
+    while (day >= start + hebrew_month_length(m, len))
+    {
+        start += hebrew_month_length(m, len);
+        m = m == (len > 380 ? 13 : 12) ? 1 : m + 1;
+    }
+    d->year = (int) y;
+    d->month = m;
+    d->day = (int) (day - start) + 1;
+    d->leap = len > 380;
+}
+
+/* -------------------------------------------------------------------- */
+/*  Chinese                                                             */
+
+/* The modern rules: months begin on the day of the new moon in Beijing
+   time; the month containing the winter solstice is the eleventh; when
+   13 months lie between two eleventh months, the first of them without
+   a major solar term is intercalary.  The solar terms come from the Sun
+   of moon_ecliptic(), so a term falling within a few minutes of
+   midnight can land on the wrong day. */
+#define BEIJING     8.0             /* hours east of Greenwich */
+
+/*  Major solar term current at the start of lunation k's month: 11 from
+    the winter solstice, 12 from Sun longitude 300 degrees, and so on.  */
+static int term(struct newmoons *t, long k)
+{
+    struct newmoon *e = entry(t, k);
+    struct moon_ecliptic ec;
+
+    if (e->term == 0)
+    {
+        moon_ecliptic(UNIXEPOCH + month_start(t, k, BEIJING, 0) - BEIJING / 24, &ec);
+        /* amod(2 + floor(lambda / 30), 12) */
+        e->term = (signed char) ((1 + (int) (ec.sunlambda / 30)) % 12 + 1);
+    }
+    return e->term;
+}
+
+/*  Lunation k holds the winter solstice.  */
+static int eleventh(struct newmoons *t, long k)
+{
+    return term(t, k + 1) == 11 && term(t, k) != 11;
+}
+
+void chinese_from_days(struct newmoons *t, int64_t day, struct lunar_date *d)
+{
+    long k = month_of(t, day, BEIJING, 0), k11 = k, next, j;
+    int num, leapyear, leapfound = 0, leap = 0, newyear = 0;
+    int64_t y;
+    int mm, dd;
+
+    while (!eleventh(t, k11)) k11--;
+    next = k11 + 12;
+    if (!eleventh(t, next)) next++;
+    leapyear = next - k11 == 13;
+
+    num = 11;
+    for (j = k11 + 1; j <= k; j++)
+    {
+        leap = leapyear && !leapfound && term(t, j) == term(t, j + 1);
+        if (leap)
+            leapfound = 1;
+        else
+        {
+            num = num % 12 + 1;
+            if (num == 1) newyear = 1;
+        }
+    }
+    civil_from_days(month_start(t, k11, BEIJING, 0), &y, &mm, &dd);
+    d->year = (int) y + newyear;
+    d->month = num;
+    d->day = (int) (day - month_start(t, k, BEIJING, 0)) + 1;
+    d->leap = leap;
+}
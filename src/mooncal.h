@@ -0,0 +1,45 @@
+/*  Lunar calendars: Islamic, Hebrew and Chinese dates  */
+
+#ifndef MOONCAL_H
+#define MOONCAL_H
+
+struct newmoon {
+    double jd;                      /* UT, 0 until computed */
+    signed char term;               /* Chinese major solar term current at
+                                       the start of the month, 1-12, 0
+                                       until computed */
+};
+
+/*  Window of true new moons, filled on demand.  Entries are indexed by
+    Brown's lunation number (lunation 1 began 1923 January 17).  A
+    Chinese date looks at up to 30 lunations, so the window should hold
+    at least 32.  */
+struct newmoons {
+    long k0;                        /* lunation number of m[0] */
+    int size;                       /* capacity of m */
+    struct newmoon *m;
+    unsigned long searches;         /* phase searches made */
+};
+
+struct lunar_date {
+    int year;
+    int month;                      /* Islamic: 1 = Muharram; Hebrew:
+                                       1 = Nisan ... 12 = Adar (Adar I in
+                                       leap years), 13 = Adar II; Chinese:
+                                       1-12 */
+    int day;
+    int leap;                       /* Chinese leap (intercalary) month;
+                                       Hebrew leap year, whose month 12
+                                       is Adar I */
+};
+
+void newmoons_init(struct newmoons *t, struct newmoon *buf, int size, double jd);
+double newmoon(struct newmoons *t, long k);
+long lunation(struct newmoons *t, double jd);
+
+void islamic_from_days(struct newmoons *t, int64_t day, struct lunar_date *d);
+void hebrew_from_days(int64_t day, struct lunar_date *d);
+int64_t days_from_hebrew(int year, int month, int day);
+void chinese_from_days(struct newmoons *t, int64_t day, struct lunar_date *d);
+
+#endif
@@ -0,0 +1,54 @@
+/*  Astronomical constants and angle helpers shared by the moontool.c
+    kernels and the modules built on them.  */
+
+#ifndef MOONCONST_H
+#define MOONCONST_H
+
+/*  Astronomical constants  */
+#define EPOCH       2444238.5      /* 1980 January 0.0 */
+
+/*  Constants defining the Sun's apparent orbit  */
+
+#define ELONGE      278.833540     /* Ecliptic longitude of the Sun at epoch 1980.0 */
+#define ELONGP      282.596403     /* Ecliptic longitude of the Sun at perigee */
+#define ECCENT      0.016718       /* Eccentricity of Earth's orbit */
+#define SUNSMAX     1.495985e8     /* Semi-major axis of Earth's orbit, km */
+#define SUNANGSIZ   0.533128       /* Sun's angular size, degrees, at
+                                      semi-major axis distance */
+/*  Elements of the Moon's orbit, epoch 1980.0  */
+#define MMLONG      64.975464      /* Moon's mean longitude at the epoch */
+#define MMLONGP     349.383063     /* Mean longitude of the perigee at the epoch */
+#define MLNODE      151.950429     /* Mean longitude of the node at the epoch */
+#define MINC        5.145396       /* Inclination of the Moon's orbit */
+#define MECC        0.054900       /* Eccentricity of the Moon's orbit */
+#define MANGSIZ     0.5181         /* Moon's angular size at distance a
+                                            from Earth */
+#define MSMAX       384401.0       /* Semi-major axis of Moon's orbit in km */
+#define MPARALLAX   0.9507         /* Parallax at distance a from Earth */
+#define SYNMONTH    29.53058868    /* Synodic month (new Moon to new Moon) */
+#define LUNATBASE   2423436.0      /* Base date for E. W. Brown's numbered
+                                      series of lunations (1923 January 16) */
+
+/*  Properties of the Earth  */
+
+#define EARTHRAD    6378.16        /* Radius of Earth in kilometres */
+
+/*  Handy mathematical functions  */
+
+#define PI 3.14159265358979323846
+
+#define SGN(x) (((x) < 0) ? -1 : ((x) > 0 ? 1 : 0))       /* Extract sign */
+#ifndef ABS
+#define ABS(x) ((x) < 0 ? (-(x)) : (x))                   /* Absolute val */
+#endif
+#define FIXANGLE(a)  ((a) < 0 ? 360.*((a)/360.-(long)((a)/360.)+1) : 360.*((a)/360.-(long)((a)/360.)))
+                                                          /* angle to 0-360 */
+#define FIXRANGLE(a) ((a) < 0 ? 2*PI*((a)/2/PI-(long)((a)/2/PI)+1) : 2*PI*((a)/2/PI-(long)((a)/2/PI)))
+                                                          /* angle to 0-2PI */
+#define TORAD(d) ((d) * (PI / 180.0))                     /* Deg->Rad     */
+#define TODEG(d) ((d) * (180.0 / PI))                     /* Rad->Deg     */
+
+#define dsin(x) (sin(TORAD((x))))                   /* Sin from deg */
+#define dcos(x) (cos(TORAD((x))))                   /* Cos from deg */
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * mooneclipse - solar and lunar eclipses at the new and full moons
+ *
+ * An eclipse needs the Moon near a node of its orbit at syzygy.  The
+ * argument of latitude F of each mean new and full moon is a linear
+ * function of the lunation number, so most lunations are rejected with
+ * one sine: with |sin F| > 0.36 no eclipse is possible (Meeus,
+ * Astronomical Algorithms, ch. 54).  Only the remaining candidates are
+ * searched for the true syzygy and given the shadow geometry.  The
+ * syzygy, latitude and distances all come from the ELP series: Walker's
+ * theory puts syzygies up to 47 minutes out and the latitude a minute of
+ * arc, and its fixed ellipse misses the ~3000 km by which the Moon is
+ * nearer at syzygy, which turns many total eclipses annular.  The
+ * geometry is geocentric and ignores the Earth's flattening, so grazing
+ * eclipses can be misclassified, and hybrid eclipses are not told apart.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include "moontool.h"
+#include "moonconst.h"
+#include "mooneclipse.h"
+
+#define MEANNEW0    2451550.09766   /* mean new moon of lunation 0, 2000 Jan 6 */
+#define MEANSYN     29.530588861    /* mean synodic month, days */
+#define F0          160.7108        /* argument of latitude at lunation 0 */
+#define FRATE       390.67050284    /* and its change per lunation, degrees */
+#define NODELIMIT   0.36            /* |sin F| above this: no eclipse */
+
+#define SUNPARALLAX (8.794 / 3600)  /* at SUNSMAX, degrees */
+#define SHADOWGROW  1.02            /* enlargement of the Earth's shadow by
+                                       its atmosphere (Danjon) */
+#define PATHCOS     0.9953          /* cosine of the slope of the Moon's
+                                       path relative to the Sun or shadow,
+                                       about 5.6 degrees */
+
+/*  Classify the syzygy at jd; returns 0 if there is no eclipse.  */
+static int geometry(double jd, int kind, struct eclipse *ev)
+{
+    double pm, ps, sm, ss, sep, umbra, penumbra;
+    double illum, age, dist, angdia, sundist, sunang;
+
+    moon_phase_elp(jd, &illum, &age, &dist, &angdia, &sundist, &sunang);
+    pm = TODEG(asin(EARTHRAD / dist));
+    ps = SUNPARALLAX * SUNSMAX / sundist;
+    sm = angdia / 2;
+    ss = sunang / 2;
+    sep = fabs(moon_latitude_elp(jd)) * PATHCOS;
+
+    ev->jd = jd;
+    ev->kind = kind;
+    ev->sep = sep;
+    if (kind == ECL_LUNAR)
+    {
+        umbra = SHADOWGROW * (pm + ps - ss);
+        penumbra = SHADOWGROW * (pm + ps + ss);
+        if (sep >= penumbra + sm) return 0;
+        if (sep < umbra + sm)
+        {
+            ev->type = sep < umbra - sm ? ECL_TOTAL : ECL_PARTIAL;
+            ev->magnitude = (umbra + sm - sep) / (2 * sm);
+        } else
+        {
+            ev->type = ECL_PENUMBRAL;
+            ev->magnitude = (penumbra + sm - sep) / (2 * sm);
+        }
+    } else
+    {
+        /* an observer can be displaced by up to the Moon's horizontal
+           parallax (less the Sun's) from the centre of the Earth */
+        if (sep >= pm - ps + sm + ss) return 0;
+        if (sep < pm - ps)
+        {
+            ev->type = sm > ss ? ECL_TOTAL : ECL_ANNULAR;
+            ev->magnitude = sm / ss;
+        } else
+        {
+            ev->type = ECL_PARTIAL;
+            ev->magnitude = (ss + sm - (sep - (pm - ps))) / (2 * ss);
+        }
+    }
+    return 1;
+}
+
+/*  ECLIPSE_SCAN  --  Find the eclipses in [jd0, jd1), in date order,
+        storing at most max of them in ev.  Returns the number stored.
+        If stats is not NULL it receives the number of lunations looked
+        at and of candidates given the full treatment.  */
+int eclipse_scan(double jd0, double jd1, struct eclipse *ev, int max,
+                 struct eclipse_stats *stats)
+{
+    long h = 2 * (long) floor((jd0 - MEANNEW0) / MEANSYN) - 2;
+    double k, mean, jd;
+    int kind, n = 0;
+    unsigned long lunations = 0, candidates = 0;
+
+    /* half lunations: even h are new moons, odd h full moons */
+    for (; n < max; h++)
+    {
+        k = 0.5 * h;
+        mean = MEANNEW0 + MEANSYN * k;
+        if (mean > jd1 + 1) break;
+        if (mean < jd0 - 1) continue;
+        lunations++;
+        if (fabs(dsin(F0 + FRATE * k)) > NODELIMIT) continue;
+
+        candidates++;
+        kind = (h & 1) ? ECL_LUNAR : ECL_SOLAR;
+        /* the true syzygy is within about 0.6 day of the mean one */
+        jd = phase_search_with(moon_phase_elp, mean - 1.5,
+                               kind == ECL_LUNAR ? 0.5 : 1.0);
+        if (jd < jd0 || jd >= jd1) continue;
+        if (geometry(jd, kind, &ev[n])) n++;
+    }
+    if (stats)
+    {
+        stats->lunations = lunations;
+        stats->candidates = candidates;
+    }
+    return n;
+}
@@ -0,0 +1,37 @@
+/*  Solar and lunar eclipses at the new and full moons  */
+
+#ifndef MOONECLIPSE_H
+#define MOONECLIPSE_H
+
+#define ECL_SOLAR       0
+#define ECL_LUNAR       1
+
+#define ECL_PENUMBRAL   0           /* lunar: penumbra only */
+#define ECL_PARTIAL     1
+#define ECL_TOTAL       2           /* solar: central, Moon larger */
+#define ECL_ANNULAR     3           /* solar: central, Sun larger */
+
+struct eclipse {
+    double jd;                      /* new or full moon, UT */
+    int kind;                       /* ECL_SOLAR or ECL_LUNAR */
+    int type;                       /* ECL_PENUMBRAL ... ECL_ANNULAR */
+    double sep;                     /* least geocentric separation of the
+                                       Moon from the Sun or shadow axis,
+                                       degrees */
+    double magnitude;               /* lunar: umbral magnitude, penumbral
+                                       for ECL_PENUMBRAL; solar: fraction
+                                       of the Sun's diameter covered where
+                                       it is greatest, or for central
+                                       eclipses the ratio of the Moon's
+                                       diameter to the Sun's */
+};
+
+struct eclipse_stats {
+    unsigned long lunations;        /* new and full moons in the range */
+    unsigned long candidates;       /* passed the node distance test */
+};
+
+int eclipse_scan(double jd0, double jd1, struct eclipse *ev, int max,
+                 struct eclipse_stats *stats);
+
+#endif
@@ -0,0 +1,334 @@
+/*
+ * moonelp - higher accuracy lunar theory for moon_phase()
+ *
+ * The Moon's longitude and distance from the truncated ELP-2000/82
+ * series given by Jean Meeus, "Astronomical Algorithms" (2nd ed.),
+ * chapter 47, and the Sun's from the solar theory of chapter 25 with
+ * its main planetary perturbations.  The periodic terms are sorted by
+ * longitude amplitude, and only the first moon_elp_terms of them are
+ * summed, so accuracy can be traded against evaluation cost.  The three
+ * additive planetary terms are always included.  Input dates are UT and
+ * converted to TD with delta_t().
+ *
+ * Over 1900-2100, with all 60 terms new and full moons come within 40
+ * seconds of Meeus's chapter 49 times (12 s rms), 16 terms within 5
+ * minutes; John Walker's theory in moontool.c is off by up to 40
+ * minutes.  "lunabench elp" prints the whole curve.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include "moonconst.h"
+#include "moontool.h"
+
+#define J2000       2451545.0      /* 2000 January 1.5 TD */
+#define AU          149597870.7    /* astronomical unit, km */
+
+int moon_elp_terms = LUNA_ELP_TERMS;
+
+/*  Periodic terms for the Moon's longitude (sum_l, 1e-6 degree) and
+    distance (sum_r, 1e-3 km) as multiples of D, M, M' and F; Meeus
+    table 47.A, largest longitude terms first.  */
+static const struct {
+    signed char mult[4];
+    int32_t l, r;
+} elp_terms[ELP_MAXTERMS] = {
+    { {  0,  0,  1,  0 },  6288774, -20905355 },
+    { {  2,  0, -1,  0 },  1274027,  -3699111 },
+    { {  2,  0,  0,  0 },   658314,  -2955968 },
+    { {  0,  0,  2,  0 },   213618,   -569925 },
+    { {  0,  1,  0,  0 },  -185116,     48888 },
+    { {  0,  0,  0,  2 },  -114332,     -3149 },
+    { {  2,  0, -2,  0 },    58793,    246158 },
+    { {  2, -1, -1,  0 },    57066,   -152138 },
+    { {  2,  0,  1,  0 },    53322,   -170733 },
+    { {  2, -1,  0,  0 },    45758,   -204586 },
+    { {  0,  1, -1,  0 },   -40923,   -129620 },
+    { {  1,  0,  0,  0 },   -34720,    108743 },
+    { {  0,  1,  1,  0 },   -30383,    104755 },
+    { {  2,  0,  0, -2 },    15327,     10321 },
+    { {  0,  0,  1,  2 },   -12528,         0 },
+    { {  0,  0,  1, -2 },    10980,     79661 },
+    { {  4,  0, -1,  0 },    10675,    -34782 },
+    { {  0,  0,  3,  0 },    10034,    -23210 },
+    { {  4,  0, -2,  0 },     8548,    -21636 },
+    { {  2,  1, -1,  0 },    -7888,     24208 },
+    { {  2,  1,  0,  0 },    -6766,     30824 },
+    { {  1,  0, -1,  0 },    -5163,     -8379 },
+    { {  1,  1,  0,  0 },     4987,    -16675 },
+    { {  2, -1,  1,  0 },     4036,    -12831 },
+    { {  2,  0,  2,  0 },     3994,    -10445 },
+    { {  4,  0,  0,  0 },     3861,    -11650 },
+    { {  2,  0, -3,  0 },     3665,     14403 },
+    { {  0,  1, -2,  0 },    -2689,     -7003 },
+    { {  2,  0, -1,  2 },    -2602,         0 },
+    { {  2, -1, -2,  0 },     2390,     10056 },
+    { {  1,  0,  1,  0 },    -2348,      6322 },
+    { {  2, -2,  0,  0 },     2236,     -9884 },
+    { {  0,  1,  2,  0 },    -2120,      5751 },
+    { {  0,  2,  0,  0 },    -2069,         0 },
+    { {  2, -2, -1,  0 },     2048,     -4950 },
+    { {  2,  0,  1, -2 },    -1773,      4130 },
+    { {  2,  0,  0,  2 },    -1595,         0 },
+    { {  4, -1, -1,  0 },     1215,     -3958 },
+    { {  0,  0,  2,  2 },    -1110,         0 },
+    { {  3,  0, -1,  0 },     -892,      3258 },
+    { {  2,  1,  1,  0 },     -810,      2616 },
+    { {  4, -1, -2,  0 },      759,     -1897 },
+    { {  0,  2, -1,  0 },     -713,     -2117 },
+    { {  2,  2, -1,  0 },     -700,      2354 },
+    { {  2,  1, -2,  0 },      691,         0 },
+    { {  2, -1,  0, -2 },      596,         0 },
+    { {  4,  0,  1,  0 },      549,     -1423 },
+    { {  0,  0,  4,  0 },      537,     -1117 },
+    { {  4, -1,  0,  0 },      520,     -1571 },
+    { {  1,  0, -2,  0 },     -487,     -1739 },
+    { {  2,  1,  0, -2 },     -399,         0 },
+    { {  0,  0,  2, -2 },     -381,     -4421 },
+    { {  1,  1,  1,  0 },      351,         0 },
+    { {  3,  0, -2,  0 },     -340,         0 },
+    { {  4,  0, -3,  0 },      330,         0 },
+    { {  2, -1,  2,  0 },      327,         0 },
+    { {  0,  2,  1,  0 },     -323,      1165 },
+    { {  1,  1, -1,  0 },      299,         0 },
+    { {  2,  0,  3,  0 },      294,         0 },
+    { {  2,  0, -1, -2 },        0,      8752 },
+};
+
+/*  Periodic terms for the Moon's latitude, 1e-6 degree, as multiples of
+    D, M, M' and F; the 30 largest of Meeus table 47.B, which leave out
+    no term of more than 3".  */
+static const struct {
+    signed char mult[4];
+    int32_t b;
+} elp_lat_terms[] = {
+    { {  0,  0,  0,  1 },  5128122 },
+    { {  0,  0,  1,  1 },   280602 },
+    { {  0,  0,  1, -1 },   277693 },
+    { {  2,  0,  0, -1 },   173237 },
+    { {  2,  0, -1,  1 },    55413 },
+    { {  2,  0, -1, -1 },    46271 },
+    { {  2,  0,  0,  1 },    32573 },
+    { {  0,  0,  2,  1 },    17198 },
+    { {  2,  0,  1, -1 },     9266 },
+    { {  0,  0,  2, -1 },     8822 },
+    { {  2, -1,  0, -1 },     8216 },
+    { {  2,  0, -2, -1 },     4324 },
+    { {  2,  0,  1,  1 },     4200 },
+    { {  2,  1,  0, -1 },    -3359 },
+    { {  2, -1, -1,  1 },     2463 },
+    { {  2, -1,  0,  1 },     2211 },
+    { {  2, -1, -1, -1 },     2065 },
+    { {  0,  1, -1, -1 },    -1870 },
+    { {  4,  0, -1, -1 },     1828 },
+    { {  0,  1,  0,  1 },    -1794 },
+    { {  0,  0,  0,  3 },    -1749 },
+    { {  0,  1, -1,  1 },    -1565 },
+    { {  1,  0,  0,  1 },    -1491 },
+    { {  0,  1,  1,  1 },    -1475 },
+    { {  0,  1,  1, -1 },    -1410 },
+    { {  0,  1,  0, -1 },    -1344 },
+    { {  1,  0,  0, -1 },    -1335 },
+    { {  0,  0,  3,  1 },     1107 },
+    { {  4,  0,  0, -1 },     1021 },
+    { {  4,  0, -1,  1 },      833 },
+};
+
+/*  DELTA_T  --  TD - UT in seconds for a Julian (UT) date, from the
+        Espenak and Meeus polynomials; a parabola outside 1800-2150.  */
+double delta_t(double jd)
+{
+    double y = 2000 + (jd - 2451544.5) / 365.2425, t;
+
+    if (y < 1800 || y >= 2150)
+    {
+        t = (y - 1820) / 100;
+        return -20 + 32 * t * t;
+    }
+    if (y < 1860)
+    {
+        t = y - 1800;
+        return 13.72 + t * (-0.332447 + t * (0.0068612 + t * (0.0041116 +
+               t * (-0.00037436 + t * (0.0000121272 + t * (-0.0000001699 +
+               t * 0.000000000875))))));
+    }
+    if (y < 1900)
+    {
+        t = y - 1860;
+        return 7.62 + t * (0.5737 + t * (-0.251754 + t * (0.01680668 +
+               t * (-0.0004473624 + t / 233174))));
+    }
+    if (y < 1920)
+    {
+        t = y - 1900;
+        return -2.79 + t * (1.494119 + t * (-0.0598939 + t * (0.0061966 -
+               t * 0.000197)));
+    }
+    if (y < 1941)
+    {
+        t = y - 1920;
+        return 21.20 + t * (0.84493 + t * (-0.076100 + t * 0.0020936));
+    }
+    if (y < 1961)
+    {
+        t = y - 1950;
+        return 29.07 + t * (0.407 + t * (-1 / 233. + t / 2547.));
+    }
+    if (y < 1986)
+    {
+        t = y - 1975;
+        return 45.45 + t * (1.067 + t * (-1 / 260. - t / 718.));
+    }
+    if (y < 2005)
+    {
+        t = y - 2000;
+        return 63.86 + t * (0.3345 + t * (-0.060374 + t * (0.0017275 +
+               t * (0.000651814 + t * 0.00002373599))));
+    }
+    if (y < 2050)
+    {
+        t = y - 2000;
+        return 62.92 + t * (0.32217 + t * 0.005589);
+    }
+    t = (y - 1820) / 100;
+    return -20 + 32 * t * t - 0.5628 * (2150 - y);
+}
+
+/*  Complex multiply (c, s) *= (c2, +-s2).  */
+#define ROT(c, s, c2, s2) do { double _t = (c) * (c2) - (s) * (s2); \
+    (s) = (s) * (c2) + (c) * (s2); (c) = _t; } while (0)
+
+/*  MOON_PHASE_ELP  --  moon_phase() with the Moon from the first
+        moon_elp_terms terms of the ELP series.  Same outputs as
+        moon_phase_double().  */
+double moon_phase_elp(
+        double  pdate,
+        double  *pphase,
+        double  *mage,
+        double  *dist,
+        double  *angdia,
+        double  *sudist,
+        double  *suangdia)
+{
+    double T, T1, Lp, D, M, Mp, F, E, sl, sr, e, c, s, Ls, Ms, es, C, R, age;
+    double cs[4][5][2];             /* cos, sin of k*D, k*M, k*M', k*F */
+    double arg[4];
+    int i, j, k, n;
+
+    T = (pdate + delta_t(pdate) / 86400 - J2000) / 36525;
+
+    /* Moon's mean longitude and the fundamental arguments, degrees */
+    Lp = 218.3164477 + T * (481267.88123421 + T * (-0.0015786 +
+         T * (1 / 538841. - T / 65194000.)));
+    arg[0] = D = 297.8501921 + T * (445267.1114034 + T * (-0.0018819 +
+         T * (1 / 545868. - T / 113065000.)));
+    arg[1] = M = 357.5291092 + T * (35999.0502909 + T * (-0.0001536 +
+         T / 24490000.));
+    arg[2] = Mp = 134.9633964 + T * (477198.8675055 + T * (0.0087414 +
+         T * (1 / 69699. - T / 14712000.)));
+    arg[3] = F = 93.2720950 + T * (483202.0175233 + T * (-0.0036539 +
+         T * (-1 / 3526000. + T / 863310000.)));
+    E = 1 - T * (0.002516 + T * 0.0000074);
+
+    /* multiples of the arguments by repeated rotation, two trig calls
+       per argument rather than two per term */
+    for (i = 0; i < 4; i++)
+    {
+        cs[i][0][0] = 1;
+        cs[i][0][1] = 0;
+        cs[i][1][0] = dcos(FIXANGLE(arg[i]));
+        cs[i][1][1] = dsin(FIXANGLE(arg[i]));
+        for (k = 2; k < 5; k++)
+        {
+            cs[i][k][0] = cs[i][k - 1][0];
+            cs[i][k][1] = cs[i][k - 1][1];
+            ROT(cs[i][k][0], cs[i][k][1], cs[i][1][0], cs[i][1][1]);
+        }
+    }
+
+    n = moon_elp_terms < 0 ? 0 :
+        moon_elp_terms > ELP_MAXTERMS ? ELP_MAXTERMS : moon_elp_terms;
+    sl = sr = 0;
+    for (j = 0; j < n; j++)
+    {
+        const signed char *mult = elp_terms[j].mult;
+        c = 1;
+        s = 0;
+        for (i = 0; i < 4; i++)
+        {
+            k = mult[i] < 0 ? -mult[i] : mult[i];
+            if (k) ROT(c, s, cs[i][k][0], mult[i] < 0 ? -cs[i][k][1] : cs[i][k][1]);
+        }
+        e = mult[1] == 0 ? 1 : mult[1] == 1 || mult[1] == -1 ? E : E * E;
+        sl += elp_terms[j].l * e * s;
+        sr += elp_terms[j].r * e * c;
+    }
+    sl += 3958 * dsin(FIXANGLE(119.75 + 131.849 * T)) +
+          1962 * dsin(FIXANGLE(Lp - F)) +
+          318 * dsin(FIXANGLE(53.09 + 479264.290 * T));
+
+    /* Sun: mean longitude and anomaly, equation of the centre */
+    Ls = 280.46646 + T * (36000.76983 + T * 0.0003032);
+    Ms = FIXANGLE(357.52911 + T * (35999.05029 - T * 0.0001537));
+    es = 0.016708634 - T * (0.000042037 + T * 0.0000001267);
+    C = (1.914602 - T * (0.004817 + T * 0.000014)) * dsin(Ms) +
+        (0.019993 - T * 0.000101) * dsin(2 * Ms) + 0.000289 * dsin(3 * Ms);
+    R = 1.000001018 * (1 - es * es) / (1 + es * dcos(Ms + C));
+
+    /* perturbations by Venus, Jupiter and the Moon, and a long period
+       term (Meeus, "Astronomical Formulae for Calculators"); T1 counts
+       from 1900 January 0.5 */
+    T1 = T + 1;
+    C += 0.00134 * dcos(FIXANGLE(153.23 + 22518.7541 * T1)) +
+         0.00154 * dcos(FIXANGLE(216.57 + 45037.5082 * T1)) +
+         0.00200 * dcos(FIXANGLE(312.69 + 32964.3577 * T1)) +
+         0.00179 * dsin(FIXANGLE(350.74 + 445267.1142 * T1 - 0.00144 * T1 * T1)) +
+         0.00178 * dsin(FIXANGLE(231.19 + 20.20 * T1));
+
+    /* elongation of the Moon from the apparent Sun; nutation is common
+       to both and cancels, aberration does not */
+    age = FIXANGLE(Lp + sl / 1e6 - (Ls + C - 0.005691611 / R));
+
+    *dist = 385000.56 + sr / 1000;
+    *pphase = (1 - dcos(age)) / 2;
+    *mage = SYNMONTH * age / 360;
+    *angdia = MANGSIZ * MSMAX / *dist;
+    *sudist = R * AU;
+    *suangdia = SUNANGSIZ * SUNSMAX / *sudist;
+    return age / 360 < 1 ? age / 360 : 0;
+}
+
+/*  MOON_LATITUDE_ELP  --  The Moon's geocentric ecliptic latitude in
+        degrees, to a few arcseconds, from the series of Meeus chapter 47.
+        Walker's theory behind moon_ecliptic() can be out by a minute of
+        arc, which decides whether marginal eclipses are total.  */
+double moon_latitude_elp(double pdate)
+{
+    double T, Lp, D, M, Mp, F, E, A1, A3, sb;
+    int j;
+
+    T = (pdate + delta_t(pdate) / 86400 - J2000) / 36525;
+    Lp = 218.3164477 + T * (481267.88123421 + T * -0.0015786);
+    D = 297.8501921 + T * (445267.1114034 + T * -0.0018819);
+    M = 357.5291092 + T * (35999.0502909 + T * -0.0001536);
+    Mp = 134.9633964 + T * (477198.8675055 + T * 0.0087414);
+    F = 93.2720950 + T * (483202.0175233 + T * -0.0036539);
+    E = 1 - T * (0.002516 + T * 0.0000074);
+    A1 = 119.75 + 131.849 * T;
+    A3 = 313.45 + 481266.484 * T;
+
+    sb = 0;
+    for (j = 0; j < (int) (sizeof(elp_lat_terms) / sizeof(elp_lat_terms[0])); j++)
+    {
+        const signed char *mult = elp_lat_terms[j].mult;
+        double e = mult[1] == 0 ? 1 : E;
+
+        sb += elp_lat_terms[j].b * e *
+              dsin(FIXANGLE(mult[0] * D + mult[1] * M + mult[2] * Mp + mult[3] * F));
+    }
+    sb += -2235 * dsin(FIXANGLE(Lp)) + 382 * dsin(FIXANGLE(A3)) +
+          175 * dsin(FIXANGLE(A1 - F)) + 175 * dsin(FIXANGLE(A1 + F)) +
+          127 * dsin(FIXANGLE(Lp - Mp)) - 115 * dsin(FIXANGLE(Lp + Mp));
+    return sb / 1e6;
+}
@@ -0,0 +1,255 @@
+/*
+ * moonevent - crossings and extrema of moon_phase() outputs
+ *
+ * One output of the kernel is sampled at a fixed step.  A sign change
+ * of value - level between two samples brackets a crossing, which is
+ * then solved by Brent's method; a sample higher (or lower) than both
+ * its neighbours brackets an extremum, refined by Brent's parabolic
+ * minimiser.  Both converge superlinearly, so the cost of an event is
+ * the samples spanning it plus a small, capped number of refinements,
+ * for any channel.
+ */
+
+#include <math.h>
+#include "moonconst.h"
+#include "moonevent.h"
+
+#define MAXITER 60                  /* kernel calls allowed per refinement */
+#define CGOLD   0.3819660112501051  /* 2 - golden ratio */
+
+/* Period after which a channel wraps back to zero, 0 if it does not, and
+   a default step that is safe for it. */
+static const struct {
+    double wrap, step;
+} channel[EV_NCHANNEL] = {
+    { 1, 5 },                       /* EV_PHASE */
+    { 0, 3 },                       /* EV_ILLUM */
+    { SYNMONTH, 5 },                /* EV_AGE */
+    { 0, 3 },                       /* EV_DIST */
+    { 0, 3 },                       /* EV_ANGDIA */
+    { 0, 30 },                      /* EV_SUDIST */
+    { 0, 30 },                      /* EV_SUANGDIA */
+};
+
+/*  MOON_EVENT_INIT  --  Set up a search of kernel (moon_phase() or one of
+        its variants) output channel with the default step and a
+        tolerance of about a second.  */
+void moon_event_init(struct moon_event_search *s, double (*kernel)(double,
+        double *, double *, double *, double *, double *, double *),
+        int channel_no)
+{
+    s->kernel = kernel;
+    s->channel = channel_no;
+    s->step = channel[channel_no].step;
+    s->anchor = 0;
+    s->tol = 1e-5;
+    s->evaluations = 0;
+}
+
+static double value(struct moon_event_search *s, double jd)
+{
+    double out[EV_NCHANNEL];
+
+    s->evaluations++;
+    out[EV_PHASE] = s->kernel(jd, &out[EV_ILLUM], &out[EV_AGE], &out[EV_DIST],
+            &out[EV_ANGDIA], &out[EV_SUDIST], &out[EV_SUANGDIA]);
+    return out[s->channel];
+}
+
+/*  Distance of v above level, reduced to within half a period for the
+    wrapping channels.  */
+static double above(const struct moon_event_search *s, double v, double level)
+{
+    double w = channel[s->channel].wrap, d = v - level;
+
+    if (w > 0) d -= w * floor(d / w + 0.5);
+    return d;
+}
+
+/*  Root of above() between a and b, whose values fa and fb differ in
+    sign; Brent's method with times taken relative to a, so the
+    tolerance is not lost in the size of the Julian date.  */
+static int zero(struct moon_event_search *s, double level, double a, double fa,
+                double fb, double len, struct moon_event *ev)
+{
+    double b = len, c = 0, fc = fa, d = len, e = len, p, q, r, t, m, tol;
+    double o = a;
+    int iter;
+
+    a = 0;
+    for (iter = 0; iter < MAXITER; iter++)
+    {
+        if ((fb > 0) == (fc > 0))
+        {
+            c = a; fc = fa; d = e = b - a;
+        }
+        if (fabs(fc) < fabs(fb))
+        {
+            a = b; b = c; c = a;
+            fa = fb; fb = fc; fc = fa;
+        }
+        tol = 0.5 * s->tol;
+        m = 0.5 * (c - b);
+        if (fabs(m) <= tol || fb == 0)
+        {
+            ev->jd = o + b;
+            ev->value = fb + level;
+            return 0;
+        }
+        if (fabs(e) >= tol && fabs(fa) > fabs(fb))
+        {
+            t = fb / fa;
+            if (a == c)
+            {
+                p = 2 * m * t;
+                q = 1 - t;
+            } else
+            {
+                q = fa / fc;
+                r = fb / fc;
+                p = t * (2 * m * q * (q - r) - (b - a) * (r - 1));
+                q = (q - 1) * (r - 1) * (t - 1);
+            }
+            if (p > 0) q = -q; else p = -p;
+            if (2 * p < 3 * m * q - fabs(tol * q) && p < fabs(0.5 * e * q))
+            {
+                e = d;
+                d = p / q;
+            } else
+            {
+                d = e = m;
+            }
+        } else
+        {
+            d = e = m;
+        }
+        a = b;
+        fa = fb;
+        b += fabs(d) > tol ? d : (m > 0 ? tol : -tol);
+        fb = above(s, value(s, o + b), level);
+    }
+    return -1;
+}
+
+/*  Minimum of sign * value over [a, a + len], where the sample x0 inside
+    has value fx0 below both ends; Brent's parabolic minimiser, again on
+    times relative to a.  */
+static int extremum(struct moon_event_search *s, double sign, double a,
+                    double len, double x0, double fx0, struct moon_event *ev)
+{
+    double lo = 0, hi = len, x = x0 - a, w = x, v = x;
+    double fx = fx0, fw = fx0, fv = fx0;
+    double d = 0, e = 0, m, tol, p, q, r, u, fu;
+    int iter;
+
+    for (iter = 0; iter < MAXITER; iter++)
+    {
+        m = 0.5 * (lo + hi);
+        tol = 0.5 * s->tol;
+        if (fabs(x - m) <= 2 * tol - 0.5 * (hi - lo))
+        {
+            ev->jd = a + x;
+            ev->value = sign * fx;
+            return 0;
+        }
+        if (fabs(e) > tol)
+        {
+            r = (x - w) * (fx - fv);
+            q = (x - v) * (fx - fw);
+            p = (x - v) * q - (x - w) * r;
+            q = 2 * (q - r);
+            if (q > 0) p = -p; else q = -q;
+            r = e;
+            e = d;
+            if (fabs(p) >= fabs(0.5 * q * r) || p <= q * (lo - x) || p >= q * (hi - x))
+            {
+                e = (x >= m ? lo : hi) - x;
+                d = CGOLD * e;
+            } else
+            {
+                d = p / q;
+                u = x + d;
+                if (u - lo < 2 * tol || hi - u < 2 * tol)
+                    d = x < m ? tol : -tol;
+            }
+        } else
+        {
+            e = (x >= m ? lo : hi) - x;
+            d = CGOLD * e;
+        }
+        u = x + (fabs(d) >= tol ? d : (d > 0 ? tol : -tol));
+        fu = sign * value(s, a + u);
+        if (fu <= fx)
+        {
+            if (u >= x) lo = x; else hi = x;
+            v = w; fv = fw;
+            w = x; fw = fx;
+            x = u; fx = fu;
+        } else
+        {
+            if (u < x) lo = u; else hi = u;
+            if (fu <= fw || w == x)
+            {
+                v = w; fv = fw;
+                w = u; fw = fu;
+            } else if (fu <= fv || v == x || v == w)
+            {
+                v = u; fv = fu;
+            }
+        }
+    }
+    return -1;
+}
+
+/*  MOON_EVENT_SCAN  --  Find events of the given kind in [jd0, jd1), in
+        date order, storing at most max of them in ev.  Returns the
+        number stored, or -1 if a refinement did not converge.  Wrapping
+        channels only cross upwards, and their extrema are the wrap
+        points, which are not reported.  */
+int moon_event_scan(struct moon_event_search *s, int kind, double level,
+        double jd0, double jd1, struct moon_event *ev, int max)
+{
+    double step = s->step, sign = kind == EV_MAXIMUM ? -1 : 1;
+    double tm, t0, t1, vm, v0, v1;
+    long k = (long) floor((jd0 - s->anchor) / step);
+    int n = 0;
+
+    if (kind == EV_RISING || kind == EV_FALLING)
+    {
+        double half = 0.5 * channel[s->channel].wrap;
+
+        t0 = s->anchor + k * step;
+        v0 = above(s, value(s, t0), level);
+        for (; n < max && t0 < jd1; t0 = t1, v0 = v1)
+        {
+            t1 = s->anchor + ++k * step;
+            v1 = above(s, value(s, t1), level);
+            if (half > 0 && fabs(v1 - v0) > half) continue;
+            if (kind == EV_RISING ? (v0 < 0 && v1 >= 0) : (v0 >= 0 && v1 < 0))
+            {
+                if (zero(s, level, t0, v0, v1, step, &ev[n]) < 0) return -1;
+                if (ev[n].jd >= jd0 && ev[n].jd < jd1) n++;
+            }
+        }
+        return n;
+    }
+
+    if (channel[s->channel].wrap > 0) return 0;
+    /* each sample t0 is compared with its neighbours, so start a step
+       early to catch an extremum just after jd0 */
+    tm = s->anchor + (k - 1) * step;
+    vm = sign * value(s, tm);
+    t0 = s->anchor + k * step;
+    v0 = sign * value(s, t0);
+    for (; n < max && tm < jd1; tm = t0, vm = v0, t0 = t1, v0 = v1)
+    {
+        t1 = s->anchor + ++k * step;
+        v1 = sign * value(s, t1);
+        if (v0 <= vm && v0 < v1)
+        {
+            if (extremum(s, sign, tm, 2 * step, t0, v0, &ev[n]) < 0) return -1;
+            if (ev[n].jd >= jd0 && ev[n].jd < jd1) n++;
+        }
+    }
+    return n;
+}
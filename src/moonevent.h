@@ -0,0 +1,44 @@
+/*  Crossings and extrema of moon_phase() outputs  */
+
+#ifndef MOONEVENT_H
+#define MOONEVENT_H
+
+#define EV_PHASE    0               /* return value, wraps from 1 to 0 */
+#define EV_ILLUM    1               /* illuminated fraction */
+#define EV_AGE      2               /* age in days, wraps at new moon */
+#define EV_DIST     3               /* distance, km */
+#define EV_ANGDIA   4               /* angular diameter, degrees */
+#define EV_SUDIST   5               /* distance to the Sun, km */
+#define EV_SUANGDIA 6               /* Sun's angular diameter, degrees */
+#define EV_NCHANNEL 7
+
+#define EV_RISING   0               /* channel crosses level upwards */
+#define EV_FALLING  1               /* channel crosses level downwards */
+#define EV_MINIMUM  2               /* local minimum, level unused */
+#define EV_MAXIMUM  3               /* local maximum, level unused */
+
+struct moon_event {
+    double jd;                      /* date of the event */
+    double value;                   /* channel value there */
+};
+
+struct moon_event_search {
+    double (*kernel)(double, double *, double *, double *, double *,
+                     double *, double *);
+    int channel;                    /* EV_PHASE ... EV_SUANGDIA */
+    double step;                    /* bracketing step in days, under half
+                                       the shortest time between events */
+    double anchor;                  /* brackets start at anchor + k step,
+                                       so scans of adjacent ranges refine
+                                       each event from the same one */
+    double tol;                     /* accuracy of event dates, days */
+    unsigned long evaluations;      /* kernel calls made so far */
+};
+
+void moon_event_init(struct moon_event_search *s, double (*kernel)(double,
+        double *, double *, double *, double *, double *, double *),
+        int channel);
+int moon_event_scan(struct moon_event_search *s, int kind, double level,
+        double jd0, double jd1, struct moon_event *ev, int max);
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * moonfit - piecewise Chebyshev representation of moon_phase()
+ *
+ * The date range is cut into equal segments, by default half a synodic
+ * month, and on each the unwrapped phase angle, illuminated fraction and
+ * distance are fitted by Chebyshev series sampled at the Chebyshev
+ * nodes.  Evaluating is a segment index and three Clenshaw recurrences,
+ * with no trigonometry at all.
+ */
+
+#include <math.h>
+#include "moonconst.h"
+#include "moonfit.h"
+
+#define MAXORDER 32
+
+/*  Number of doubles needed for the coefficients of nseg segments.  */
+size_t moon_cheb_size(int nseg, int order)
+{
+    return (size_t) nseg * CHEB_NCHAN * order;
+}
+
+/*  MOON_CHEB_FIT  --  Fit kernel (moon_phase() or one of its variants)
+        on nseg segments of seglen days starting at jd0, with order
+        coefficients per channel (at most 32).  coef must hold
+        moon_cheb_size(nseg, order) doubles.  */
+void moon_cheb_fit(struct moon_cheb *c, double (*kernel)(double, double *,
+        double *, double *, double *, double *, double *),
+        double jd0, double seglen, int nseg, int order, double *coef)
+{
+    double f[CHEB_NCHAN][MAXORDER], node[MAXORDER], mean0, mean, t, sum;
+    double illum, age, dist, angdia, sundist, sunang;
+    int s, j, k, ch;
+
+    if (order > MAXORDER) order = MAXORDER;
+    c->jd0 = jd0;
+    c->seglen = seglen;
+    c->nseg = nseg;
+    c->order = order;
+    c->coef = coef;
+
+    for (k = 0; k < order; k++)
+        node[k] = cos(PI * (k + 0.5) / order);
+
+    /* the phase is unwrapped against the mean synodic motion; the true
+       phase never strays from it by more than a few hundredths */
+    mean0 = kernel(jd0, &illum, &age, &dist, &angdia, &sundist, &sunang);
+
+    for (s = 0; s < nseg; s++, coef += CHEB_NCHAN * order)
+    {
+        for (k = 0; k < order; k++)
+        {
+            t = jd0 + seglen * (s + 0.5 * (node[k] + 1));
+            f[CHEB_PHASE][k] = kernel(t, &illum, &age, &dist, &angdia,
+                                      &sundist, &sunang);
+            mean = mean0 + (t - jd0) / SYNMONTH;
+            f[CHEB_PHASE][k] += floor(mean - f[CHEB_PHASE][k] + 0.5);
+            f[CHEB_ILLUM][k] = illum;
+            f[CHEB_DIST][k] = dist;
+        }
+        for (ch = 0; ch < CHEB_NCHAN; ch++)
+            for (j = 0; j < order; j++)
+            {
+                sum = 0;
+                for (k = 0; k < order; k++)
+                    sum += f[ch][k] * cos(PI * j * (k + 0.5) / order);
+                coef[ch * order + j] = (j ? 2. : 1.) * sum / order;
+            }
+    }
+}
+
+/*  Clenshaw recurrences for sum c[j] T_j(x) of the three channels,
+    run side by side so their dependency chains overlap.  */
+static void clenshaw3(const double *c, int n, double x, double *f)
+{
+    double b1[CHEB_NCHAN] = { 0 }, b2[CHEB_NCHAN] = { 0 }, t, x2 = 2 * x;
+    int j, ch;
+
+    for (j = n - 1; j > 0; j--)
+        for (ch = 0; ch < CHEB_NCHAN; ch++)
+        {
+            t = x2 * b1[ch] - b2[ch] + c[ch * n + j];
+            b2[ch] = b1[ch];
+            b1[ch] = t;
+        }
+    for (ch = 0; ch < CHEB_NCHAN; ch++)
+        f[ch] = x * b1[ch] - b2[ch] + c[ch * n];
+}
+
+/*  MOON_CHEB_EVAL  --  Phase (0 to 1) at jd from the fitted series, with
+        the illuminated fraction, distance and angular diameter through
+        the pointers as moon_phase() does.  Returns -1 outside the fitted
+        range.  */
+double moon_cheb_eval(const struct moon_cheb *c, double jd, double *pphase,
+        double *dist, double *angdia)
+{
+    double u, f[CHEB_NCHAN];
+    int s;
+
+    u = (jd - c->jd0) / c->seglen;
+    if (u < 0 || u > c->nseg) return -1;
+    s = (int) u;
+    if (s == c->nseg) s--;                  /* end point of the last segment */
+    clenshaw3(c->coef + (size_t) s * CHEB_NCHAN * c->order, c->order,
+              2 * (u - s) - 1, f);
+
+    *pphase = f[CHEB_ILLUM];
+    *dist = f[CHEB_DIST];
+    *angdia = MANGSIZ * MSMAX / *dist;
+    f[CHEB_PHASE] -= floor(f[CHEB_PHASE]);
+    return f[CHEB_PHASE] < 1 ? f[CHEB_PHASE] : 0;
+}
@@ -0,0 +1,28 @@
+/*  Piecewise Chebyshev representation of moon_phase()  */
+
+#ifndef MOONFIT_H
+#define MOONFIT_H
+
+#include <stddef.h>
+
+#define CHEB_PHASE  0               /* unwrapped phase, turns */
+#define CHEB_ILLUM  1               /* illuminated fraction */
+#define CHEB_DIST   2               /* distance, km */
+#define CHEB_NCHAN  3
+
+struct moon_cheb {
+    double jd0;                     /* start of the first segment */
+    double seglen;                  /* segment length in days */
+    int nseg;                       /* number of segments */
+    int order;                      /* coefficients per channel and segment */
+    const double *coef;             /* [nseg][CHEB_NCHAN][order] */
+};
+
+size_t moon_cheb_size(int nseg, int order);
+void moon_cheb_fit(struct moon_cheb *c, double (*kernel)(double, double *,
+        double *, double *, double *, double *, double *),
+        double jd0, double seglen, int nseg, int order, double *coef);
+double moon_cheb_eval(const struct moon_cheb *c, double jd, double *pphase,
+        double *dist, double *angdia);
+
+#endif
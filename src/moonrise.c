@@ -0,0 +1,200 @@
+/*
+ * moonrise - moonrise, moonset and transit for an observer
+ *
+ * The Moon's right ascension and declination are worked out from
+ * moon_ecliptic() at the start, middle and end of each day and
+ * interpolated by a parabola; only sidereal time is evaluated exactly
+ * in between.  The altitude is sampled every hour and each triple of
+ * samples fitted by a parabola whose roots give rise and set
+ * (Montenbruck and Pfleger, Astronomy on the Personal Computer), then
+ * refined by one Newton step.  Every day costs the same: two Moon
+ * positions (the end of one day is the start of the next), 25 altitudes
+ * and one more per rise or set, whatever the latitude.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include "moontool.h"
+#include "moonconst.h"
+#include "moonrise.h"
+
+#define J2000       2451545.0
+#define SIDRATE     360.98564736629 /* Greenwich sidereal time, degrees/day */
+
+/* Values of a quantity at the start, middle and end of a day, as the
+   coefficients of y(t) = c + b t + a t^2 for the day fraction t */
+struct parabola {
+    double a, b, c;
+};
+
+static void fit(struct parabola *p, double y0, double y1, double y2)
+{
+    p->c = y0;
+    p->b = -3 * y0 + 4 * y1 - y2;
+    p->a = 2 * y0 - 4 * y1 + 2 * y2;
+}
+
+#define VALUE(p, t) (((p).a * (t) + (p).b) * (t) + (p).c)
+#define SLOPE(p, t) (2 * (p).a * (t) + (p).b)
+
+/*  Moon's geocentric right ascension, declination and horizontal
+    parallax at jd, in degrees.  */
+static void position(double jd, double *ra, double *dec, double *hp)
+{
+    struct moon_ecliptic e;
+    double eps, sl, cl, sb, cb, se, ce;
+
+    moon_ecliptic(jd, &e);
+    eps = TORAD(23.439291 - 0.0130042 * (jd - J2000) / 36525);
+    sl = dsin(e.lambda); cl = dcos(e.lambda);
+    sb = dsin(e.beta); cb = dcos(e.beta);
+    se = sin(eps); ce = cos(eps);
+    *ra = FIXANGLE(TODEG(atan2(sl * cb * ce - sb * se, cl * cb)));
+    *dec = TODEG(asin(sb * ce + cb * se * sl));
+    *hp = TODEG(asin(EARTHRAD / e.dist));
+}
+
+struct day {
+    struct parabola ra, dec;        /* degrees */
+    double lst0;                    /* local sidereal time at t = 0 */
+    double hp;                      /* horizontal parallax, degrees */
+    double sinlat, coslat, sinh0;
+};
+
+/*  Hour angle in degrees at day fraction t.  */
+static double hour_angle(const struct day *d, double t)
+{
+    return d->lst0 + SIDRATE * t - VALUE(d->ra, t);
+}
+
+/*  Sine of the altitude less that of the standard altitude.  */
+static double altitude(const struct day *d, double t)
+{
+    double dec = TORAD(VALUE(d->dec, t));
+
+    return d->sinlat * sin(dec) +
+           d->coslat * cos(dec) * dcos(hour_angle(d, t)) - d->sinh0;
+}
+
+/*  Roots in [-1, 1] of the parabola through (-1, ym), (0, y0), (1, yp);
+    returns their number, the first in *z1.  */
+static int quad(double ym, double y0, double yp, double *z1, double *z2,
+                double *ye)
+{
+    double a = 0.5 * (yp + ym) - y0, b = 0.5 * (yp - ym), c = y0;
+    double xe, dis, dx;
+    int n = 0;
+
+    if (a == 0)
+    {
+        *ye = y0;
+        *z1 = -c / b;
+        return fabs(*z1) <= 1;
+    }
+    xe = -b / (2 * a);
+    *ye = (a * xe + b) * xe + c;
+    dis = b * b - 4 * a * c;
+    if (dis < 0) return 0;
+    dx = 0.5 * sqrt(dis) / fabs(a);
+    *z1 = xe - dx;
+    *z2 = xe + dx;
+    if (fabs(*z1) <= 1) n++;
+    if (fabs(*z2) <= 1) n++;
+    if (*z1 < -1) *z1 = *z2;
+    return n;
+}
+
+/*  One Newton step on the altitude from root z of the hourly parabola
+    through ym, y0, yp centred on hour.  */
+static double refine(const struct day *d, int hour, double z,
+                     double ym, double y0, double yp)
+{
+    double a = 0.5 * (yp + ym) - y0, b = 0.5 * (yp - ym);
+    double t = (hour + z) / 24, slope = 24 * (2 * a * z + b);
+
+    return slope != 0 ? t - altitude(d, t) / slope : t;
+}
+
+static void solve_day(const struct day *d, double jd, struct moon_day *r)
+{
+    double ym, y0, yp, z1, z2, ye, t, h, dec;
+    int hour, n, i;
+
+    r->rise = r->set = r->transit = -1;
+    ym = altitude(d, 0);
+    r->up = ym > 0;
+    for (hour = 1; hour < 24; hour += 2)
+    {
+        y0 = altitude(d, hour / 24.);
+        yp = altitude(d, (hour + 1) / 24.);
+        n = quad(ym, y0, yp, &z1, &z2, &ye);
+        if (n == 1)
+        {
+            t = jd + refine(d, hour, z1, ym, y0, yp);
+            if (ym < 0)
+            {
+                if (r->rise < 0) r->rise = t;
+            } else if (r->set < 0) r->set = t;
+        } else if (n == 2)
+        {
+            if (ye < 0) { double z = z1; z1 = z2; z2 = z; }
+            if (r->rise < 0) r->rise = jd + refine(d, hour, z1, ym, y0, yp);
+            if (r->set < 0) r->set = jd + refine(d, hour, z2, ym, y0, yp);
+        }
+        ym = yp;
+    }
+
+    /* transit: the hour angle gains about 348 degrees a day, so a
+       Newton iteration from the linear guess converges in two steps */
+    h = FIXANGLE(hour_angle(d, 0));
+    t = h > 0 ? (360 - h) / (SIDRATE - SLOPE(d->ra, 0.5)) : 0;
+    for (i = 0; i < 2; i++)
+    {
+        h = hour_angle(d, t);
+        h -= 360 * floor(h / 360 + 0.5);
+        t -= h / (SIDRATE - SLOPE(d->ra, t));
+    }
+    if (t >= 0 && t < 1)
+    {
+        r->transit = jd + t;
+        dec = VALUE(d->dec, t);
+        h = TODEG(asin(d->sinlat * dsin(dec) + d->coslat * dcos(dec)));
+        r->transit_alt = h - d->hp * dcos(h);   /* parallax in altitude */
+    }
+}
+
+/*  MOON_RISESET  --  Rise, set and transit of the Moon seen by o on the
+        ndays days starting at Julian date jd (UT; pass local midnight
+        for local days).  The Moon's upper limb is taken to touch the
+        horizon with mean refraction, the standard altitude
+        0.7275 hp - 34' of Meeus ch. 15.  */
+void moon_riseset(const struct observer *o, double jd, int ndays,
+                  struct moon_day *days)
+{
+    struct day d;
+    double ra[3], dec[3], hp[3];
+    int i;
+
+    d.sinlat = dsin(o->lat);
+    d.coslat = dcos(o->lat);
+    position(jd, &ra[0], &dec[0], &hp[0]);
+    for (i = 0; i < ndays; i++, jd += 1)
+    {
+        position(jd + 0.5, &ra[1], &dec[1], &hp[1]);
+        position(jd + 1, &ra[2], &dec[2], &hp[2]);
+        /* keep the right ascension continuous over the day */
+        if (ra[1] < ra[0] - 180) ra[1] += 360;
+        if (ra[2] < ra[1] - 180) ra[2] += 360;
+        fit(&d.ra, ra[0], ra[1], ra[2]);
+        fit(&d.dec, dec[0], dec[1], dec[2]);
+        d.lst0 = FIXANGLE(280.46061837 + SIDRATE * (jd - J2000) + o->lon);
+        d.hp = hp[1];
+        d.sinh0 = dsin(0.7275 * hp[1] - 0.5667);
+        solve_day(&d, jd, &days[i]);
+
+        ra[0] = FIXANGLE(ra[2]);
+        dec[0] = dec[2];
+        hp[0] = hp[2];
+    }
+}
@@ -0,0 +1,25 @@
+/*  Moonrise, moonset and transit for an observer  */
+
+#ifndef MOONRISE_H
+#define MOONRISE_H
+
+struct observer {
+    double lat;                     /* latitude, degrees north */
+    double lon;                     /* longitude, degrees east */
+};
+
+struct moon_day {
+    double rise, set, transit;      /* Julian dates, UT; -1 if the event
+                                       does not happen that day, the first
+                                       if it happens twice (near the
+                                       polar circles) */
+    double transit_alt;             /* topocentric altitude at transit,
+                                       degrees, without refraction */
+    int up;                         /* Moon above the horizon at the start
+                                       of the day */
+};
+
+void moon_riseset(const struct observer *o, double jd, int ndays,
+                  struct moon_day *days);
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * moonsky - altitude and azimuth of the Moon for an observer
+ *
+ * Everything that changes slowly is worked out once per day and kept
+ * in struct moon_sky: the rotation from ecliptic to equatorial axes for
+ * the day's obliquity, the sidereal time at 0h and the observer's
+ * latitude terms.  A sample then costs one moon_ecliptic() call, a
+ * matrix product, the sine and cosine of the sidereal time and the
+ * final atan2()s.  Altitudes are topocentric, without refraction.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include "moontool.h"
+#include "moonconst.h"
+#include "moonsky.h"
+
+#define J2000       2451545.0
+#define SIDRATE     360.98564736629 /* Greenwich sidereal time, degrees/day */
+
+void moon_sky_init(struct moon_sky *s, const struct observer *o)
+{
+    s->o = *o;
+    s->day = 0;
+    s->sinlat = dsin(o->lat);
+    s->coslat = dcos(o->lat);
+}
+
+static void set_day(struct moon_sky *s, double day)
+{
+    double eps = TORAD(23.439291 - 0.0130042 * (day - J2000) / 36525);
+
+    s->day = day;
+    s->eq[0][0] = 1; s->eq[0][1] = 0;        s->eq[0][2] = 0;
+    s->eq[1][0] = 0; s->eq[1][1] = cos(eps); s->eq[1][2] = -sin(eps);
+    s->eq[2][0] = 0; s->eq[2][1] = sin(eps); s->eq[2][2] = cos(eps);
+    s->lst0 = FIXANGLE(280.46061837 + SIDRATE * (day - J2000) + s->o.lon);
+}
+
+/*  MOON_SKY_ALTAZ  --  Topocentric altitude and azimuth (from north
+        through east) of the Moon at Julian date jd, in degrees.  */
+void moon_sky_altaz(struct moon_sky *s, double jd, double *alt, double *az)
+{
+    struct moon_ecliptic e;
+    double day = floor(jd - 0.5) + 0.5, v[3], x, y, z, sl, cl, u, w, h, hp;
+    int i;
+
+    if (day != s->day) set_day(s, day);
+
+    moon_ecliptic(jd, &e);
+    v[0] = dcos(e.beta) * dcos(e.lambda);
+    v[1] = dcos(e.beta) * dsin(e.lambda);
+    v[2] = dsin(e.beta);
+    x = y = z = 0;
+    for (i = 0; i < 3; i++)
+    {
+        x += s->eq[0][i] * v[i];
+        y += s->eq[1][i] * v[i];
+        z += s->eq[2][i] * v[i];
+    }
+
+    /* into the hour angle frame, then tilt by the latitude */
+    sl = dsin(s->lst0 + SIDRATE * (jd - day));
+    cl = dcos(s->lst0 + SIDRATE * (jd - day));
+    u = x * cl + y * sl;                    /* cos dec cos H */
+    w = x * sl - y * cl;                    /* cos dec sin H */
+    h = atan2(s->sinlat * z + s->coslat * u,
+              hypot(s->sinlat * u - s->coslat * z, w));
+    hp = asin(EARTHRAD / e.dist);
+    *alt = TODEG(h - hp * cos(h));
+    *az = FIXANGLE(TODEG(atan2(w, s->sinlat * u - s->coslat * z)) + 180);
+}
+
+/*  MOON_SKY_TRACK  --  n samples step days apart from jd0; either output
+        array may be NULL.  */
+void moon_sky_track(struct moon_sky *s, double jd0, double step, int n,
+                    double *alt, double *az)
+{
+    double a, z;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        moon_sky_altaz(s, jd0 + i * step, &a, &z);
+        if (alt) alt[i] = a;
+        if (az) az[i] = z;
+    }
+}
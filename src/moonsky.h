@@ -0,0 +1,22 @@
+/*  Altitude and azimuth of the Moon for an observer  */
+
+#ifndef MOONSKY_H
+#define MOONSKY_H
+
+#include "moonrise.h"
+
+struct moon_sky {
+    struct observer o;
+    double day;                     /* 0h UT of the cached day, or 0 */
+    double eq[3][3];                /* ecliptic to equatorial rotation for
+                                       the obliquity of the day */
+    double lst0;                    /* local sidereal time at day, degrees */
+    double sinlat, coslat;
+};
+
+void moon_sky_init(struct moon_sky *s, const struct observer *o);
+void moon_sky_altaz(struct moon_sky *s, double jd, double *alt, double *az);
+void moon_sky_track(struct moon_sky *s, double jd0, double step, int n,
+                    double *alt, double *az);
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ * moonstep - moon_phase() at equally spaced dates
+ *
+ * The Sun's and Moon's mean anomalies and the mean elongation are linear
+ * in time, so their sines and cosines can be advanced from one sample to
+ * the next by a fixed rotation.  Everything else in moon_phase() is a
+ * correction of at most a few degrees to one of those arguments, applied
+ * by the angle addition formulas with short series for the sine and cosine
+ * of the small correction.  A sample then costs a few dozen multiplies
+ * and no calls to sin() or cos().
+ *
+ * The rotations are renormalised every RENORM samples, and every resync
+ * samples the state is seeded again from the exact arguments.
+ */
+
+#include <math.h>
+#include "moonconst.h"
+#include "moonstep.h"
+
+#define RENORM 64
+
+/* arguments at EPOCH and their rates per day, degrees */
+static const double arg0[STEP_NARG] = {
+    ELONGE - ELONGP, MMLONG - MMLONGP, MMLONG - ELONGE
+};
+static const double argrate[STEP_NARG] = {
+    360 / 365.2422, 13.1763966 - 0.1114041, 13.1763966 - 360 / 365.2422
+};
+
+/*  sin and cos of a small angle x in radians; good to 1e-15 for |x| < 0.5,
+    far more than the corrections in moon_phase() ever reach.  */
+static void small_sincos(double x, double *s, double *c)
+{
+    double x2 = x * x;
+
+    *s = x * (1 + x2 * (-1. / 6 + x2 * (1. / 120 + x2 * (-1. / 5040 +
+            x2 * (1. / 362880 - x2 * (1. / 39916800))))));
+    *c = 1 + x2 * (-0.5 + x2 * (1. / 24 + x2 * (-1. / 720 + x2 * (1. / 40320 +
+            x2 * (-1. / 3628800 + x2 * (1. / 479001600))))));
+}
+
+/*  Seed the current sines and cosines from the exact arguments.  */
+static void step_seed(struct moon_stepper *st)
+{
+    double t;
+    int k;
+
+    for (k = 0; k < STEP_NARG; k++)
+    {
+        t = st->turn0[k] + st->n * st->rate[k];
+        t = 2 * PI * (t - floor(t));
+        st->sc[k][0] = sin(t);
+        st->sc[k][1] = cos(t);
+    }
+}
+
+/*  MOON_STEP_INIT  --  Prepare to evaluate at jd0, jd0 + step, ...
+        resync is the number of samples between exact re-seeds of the
+        recurrences (0 for never).  */
+void moon_step_init(struct moon_stepper *st, double jd0, double step, int resync)
+{
+    double day = jd0 - EPOCH, t;
+    int k;
+
+    st->jd0 = jd0;
+    st->step = step;
+    st->n = 0;
+    st->resync = st->toseed = resync;
+    st->tonorm = RENORM;
+    for (k = 0; k < STEP_NARG; k++)
+    {
+        t = (arg0[k] + argrate[k] * day) / 360;
+        st->turn0[k] = t - floor(t);
+        t = argrate[k] * step / 360;
+        st->rate[k] = t - floor(t);
+        st->rot[k][0] = sin(2 * PI * st->rate[k]);
+        st->rot[k][1] = cos(2 * PI * st->rate[k]);
+    }
+    step_seed(st);
+}
+
+/*  MOON_STEP  --  moon_phase() at the next sample date, then advance.  Same outputs as moon_phase().  */
+double moon_step(struct moon_stepper *st, double *pphase, double *mage,
+        double *dist, double *angdia, double *sudist, double *suangdia)
+{
+    const double e = ECCENT;
+    double sM, cM, sMM, cMM, sD, cD, s2M, c2M, s2D, c2D, sL1, cL1,
+           delta, sd, cd, F, Ev, Ae, A3, eps, se, ce, sMmP, cMmP,
+           mEc, A4, eta, V, zeta, sz, cz, age, s, c, r;
+    int k, renorm;
+
+    sM = st->sc[STEP_M][0];   cM = st->sc[STEP_M][1];
+    sMM = st->sc[STEP_MM][0]; cMM = st->sc[STEP_MM][1];
+    sD = st->sc[STEP_D][0];   cD = st->sc[STEP_D][1];
+    s2M = 2 * sM * cM;        c2M = cM * cM - sM * sM;
+    s2D = 2 * sD * cD;        c2D = cD * cD - sD * sD;
+    sL1 = s2D * cMM - c2D * sMM;            /* 2D - MM */
+    cL1 = c2D * cMM + s2D * sMM;
+
+    /* Sun: delta = Ec - M, the equation of the centre */
+    delta = 2 * e * sM + 1.25 * e * e * s2M +
+            e * e * e * (s2M * cM + c2M * sM);
+    small_sincos(delta, &sd, &cd);
+    F = (1 + e * (cM * cd - sM * sd)) / (1 - e * e);
+
+    /* Moon: corrections to the mean arguments, in radians */
+    small_sincos(2 * delta, &s, &c);
+    Ev = TORAD(1.2739) * (sL1 * c - cL1 * s);
+    Ae = TORAD(0.1858) * sM;
+    A3 = TORAD(0.37) * sM;
+    eps = Ev - Ae - A3;                     /* MmP = MM + eps */
+    small_sincos(eps, &se, &ce);
+    sMmP = sMM * ce + cMM * se;
+    cMmP = cMM * ce - sMM * se;
+    mEc = TORAD(6.2886) * sMmP;
+    A4 = TORAD(0.214) * 2 * sMmP * cMmP;
+    eta = Ev + mEc - Ae + A4 - delta;       /* lP - Lambdasun = D + eta */
+    small_sincos(2 * eta, &s, &c);
+    V = TORAD(0.6583) * (s2D * c + c2D * s);
+    zeta = eta + V;                         /* MoonAge = D + zeta */
+
+    age = st->turn0[STEP_D] + st->n * st->rate[STEP_D] + zeta / (2 * PI);
+    age -= floor(age);
+    small_sincos(zeta, &sz, &cz);
+    *pphase = (1 - (cD * cz - sD * sz)) / 2;
+    small_sincos(eps + mEc, &s, &c);
+    *dist = (MSMAX * (1 - MECC * MECC)) / (1 + MECC * (cMM * c - sMM * s));
+    *angdia = MANGSIZ * MSMAX / *dist;
+    *mage = SYNMONTH * age;
+    *sudist = SUNSMAX / F;
+    *suangdia = F * SUNANGSIZ;
+
+    /* advance */
+    st->n++;
+    if (st->resync > 0 && --st->toseed == 0)
+    {
+        st->toseed = st->resync;
+        step_seed(st);
+        return age < 1 ? age : 0;
+    }
+    renorm = --st->tonorm == 0;
+    if (renorm) st->tonorm = RENORM;
+    for (k = 0; k < STEP_NARG; k++)
+    {
+        s = st->sc[k][0] * st->rot[k][1] + st->sc[k][1] * st->rot[k][0];
+        c = st->sc[k][1] * st->rot[k][1] - st->sc[k][0] * st->rot[k][0];
+        if (renorm)
+        {
+            r = (3 - (s * s + c * c)) / 2;  /* one Newton step to |sc| = 1 */
+            s *= r;
+            c *= r;
+        }
+        st->sc[k][0] = s;
+        st->sc[k][1] = c;
+    }
+    return age < 1 ? age : 0;
+}
@@ -0,0 +1,30 @@
+/*  Fixed-step evaluation of moon_phase() by angle-addition recurrences  */
+
+#ifndef MOONSTEP_H
+#define MOONSTEP_H
+
+#define STEP_M      0               /* Sun's mean anomaly */
+#define STEP_MM     1               /* Moon's mean anomaly */
+#define STEP_D      2               /* mean elongation from the Sun's perigee
+                                       longitude frame, ml - M - ELONGP */
+#define STEP_NARG   3
+
+struct moon_stepper {
+    double jd0;                     /* date of the first sample */
+    double step;                    /* days between samples */
+    long n;                         /* samples taken; the next is at
+                                       jd0 + n * step */
+    int resync;                     /* samples between exact re-seeds, 0 never */
+    int toseed, tonorm;             /* samples to the next re-seed and
+                                       renormalisation */
+    double turn0[STEP_NARG];        /* arguments at the first sample, turns */
+    double rate[STEP_NARG];         /* argument increments per sample, turns */
+    double rot[STEP_NARG][2];       /* sin, cos of the increments */
+    double sc[STEP_NARG][2];        /* sin, cos of the current arguments */
+};
+
+void moon_step_init(struct moon_stepper *st, double jd0, double step, int resync);
+double moon_step(struct moon_stepper *st, double *pphase, double *mage,
+        double *dist, double *angdia, double *sudist, double *suangdia);
+
+#endif
@@ -1,3 +1,47 @@
+/*  Kernel used by moon_phase(), chosen at build time with -DLUNA_KERNEL=n  */
+#define LUNA_KERNEL_DOUBLE  0       /* double precision, libm trig */
+#define LUNA_KERNEL_FLOAT   1       /* single precision, polynomial trig */
+#define LUNA_KERNEL_ELP     2       /* truncated ELP-2000/82 series */
+#ifndef LUNA_KERNEL
+#define LUNA_KERNEL LUNA_KERNEL_DOUBLE
+#endif
+
+/*  Number of ELP periodic terms summed by moon_phase_elp(), 0 to
+    ELP_MAXTERMS; the default can be set with -DLUNA_ELP_TERMS=n.  */
+#define ELP_MAXTERMS 60
+#ifndef LUNA_ELP_TERMS
+#define LUNA_ELP_TERMS ELP_MAXTERMS
+#endif
+extern int moon_elp_terms;
+
+typedef double (*moon_phase_fn)(double, double *, double *, double *,
+                                double *, double *, double *);
+
+double moon_phase_double(double pdate, double *pphase, double *mage,
+        double *dist, double *angdia, double *sudist, double *suangdia);
+double moon_phase_float(double pdate, double *pphase, double *mage,
+        double *dist, double *angdia, double *sudist, double *suangdia);
+double moon_phase_elp(double pdate, double *pphase, double *mage,
+        double *dist, double *angdia, double *sudist, double *suangdia);
+double moon_latitude_elp(double pdate);
+double delta_t(double jd);
+
+/*  Geocentric positions behind moon_phase_double()  */
+struct moon_ecliptic {
+    double lambda;              /* Moon's ecliptic longitude, degrees */
+    double beta;                /* Moon's ecliptic latitude, degrees */
+    double node;                /* longitude of the ascending node, degrees */
+    double orbitlon;            /* Moon's true longitude in its orbit, from
+                                   which moon_phase() takes the age */
+    double dist;                /* Moon's distance, km */
+    double angdia;              /* Moon's angular diameter, degrees */
+    double sunlambda;           /* Sun's ecliptic longitude, degrees */
+    double sundist;             /* Sun's distance, km */
+    double sunangdia;           /* Sun's angular diameter, degrees */
+};
+
+void moon_ecliptic(double pdate, struct moon_ecliptic *e);
+
 double moon_phase(
         double  pdate,                      /* Date for which to calculate phase */
         double  *pphase,                    /* Illuminated fraction */
@@ -7,8 +51,19 @@ double moon_phase(
         double  *sudist,                    /* Distance to Sun */
         double  *suangdia);                  /* Sun's angular diameter */
 
+double phase_search_with(moon_phase_fn kernel, double jd, double target_phase);
 double phase_search_forward(double jd,double target_phase);
 
+struct phase_search_stats {
+    unsigned long calls;        /* phase_search_cached() calls */
+    unsigned long hits;         /* calls answered from the cache */
+    unsigned long evaluations;  /* moon_phase() calls made by searches */
+};
+
+double phase_search_cached(double jd,double target_phase);
+const struct phase_search_stats *phase_search_stats(void);
+
+int64_t days_from_civil(int64_t y, int m, int d);
+void civil_from_days(int64_t z, int64_t *y, int *m, int *d);
 double jtime(struct tm *t);
 struct tm timej(double jtime);
-struct tm tm2utc(struct tm *t, double utc_offset);
@@ -0,0 +1,78 @@
+/*
+ * chebgen - write a moonfit Chebyshev table as C source
+ *
+ * usage: chebgen [-y first_year] [-n years] [-o order] [-s segment_days]
+ *
+ * The table is fitted to moon_phase() as built (see LUNA_KERNEL) and
+ * printed to standard output as a struct moon_cheb named moon_cheb_table.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "moontool.h"
+#include "moonconst.h"
+#include "moonfit.h"
+
+int main(int argc, char *argv[])
+{
+    struct moon_cheb c;
+    struct tm start = { .tm_mday = 1 };
+    double *coef, jd0, jd1, seglen = SYNMONTH / 2;
+    int year = 1900, years = 200, order = 12, nseg, i, j;
+    size_t n;
+
+    for (i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-y") == 0) year = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-n") == 0) years = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-o") == 0) order = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0) seglen = atof(argv[i + 1]);
+        else break;
+    }
+    if (i < argc || years <= 0 || order < 2 || order > 32 || seglen <= 0)
+    {
+        fprintf(stderr, "usage: chebgen [-y first_year] [-n years] "
+                        "[-o order 2-32] [-s segment_days]\n");
+        return 1;
+    }
+
+    start.tm_year = year - 1900;
+    jd0 = jtime(&start);
+    start.tm_year += years;
+    jd1 = jtime(&start);
+    nseg = (int) ((jd1 - jd0) / seglen) + 1;
+    n = moon_cheb_size(nseg, order);
+    coef = malloc(n * sizeof(double));
+    if (!coef)
+    {
+        fprintf(stderr, "chebgen: out of memory\n");
+        return 1;
+    }
+    moon_cheb_fit(&c, moon_phase, jd0, seglen, nseg, order, coef);
+
+    printf("/* Generated by chebgen -y %d -n %d -o %d -s %.17g */\n\n",
+           year, years, order, seglen);
+    printf("#include \"moonfit.h\"\n\n");
+    printf("static const double moon_cheb_coef[%lu] = {\n", (unsigned long) n);
+    for (i = 0; i < (int) n; i += 3)
+    {
+        printf(" ");
+        for (j = i; j < i + 3 && j < (int) n; j++)
+            printf(" %.17g,", coef[j]);
+        printf("\n");
+    }
+    printf("};\n\n");
+    printf("const struct moon_cheb moon_cheb_table = {\n"
+           "    %.17g, %.17g, %d, %d, moon_cheb_coef\n};\n",
+           jd0, seglen, nseg, order);
+    free(coef);
+    return 0;
+}
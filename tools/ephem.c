@@ -0,0 +1,665 @@
+/*
+ * ephem - bulk ephemeris generation on several threads
+ *
+ * usage: ephem [-j threads] [-m minutes] [-c days] [-f csv|bin] [-o file]
+ *              first_year last_year
+ *        ephem -B [-j threads] [-m minutes] [-c days] [-f csv|bin]
+ *              first_year last_year
+ *
+ * Writes moon_phase() every -m minutes (default 1) from the start of
+ * first_year to the end of last_year, with new and full moons, perigees
+ * and apogees in their places, to -o (default standard output).  -f csv
+ * (the default) writes a header line and then
+ *
+ *      2024-01-11T12:00,,0.999930,0.000000,29.5286,370337.2,0.53794
+ *      2024-01-11T12:12:24,new moon,,,,,
+ *
+ * and -f bin packed struct ephem_record, after a 16 byte header of
+ * "LUNAEPH1", the record size and the step in seconds.  -B runs the
+ * scaling benchmark instead: the same range on 1 up to -j threads
+ * (default 4), reporting rows per second and checking that every run
+ * produced the same output, after timing the CSV formatter against
+ * snprintf().
+ *
+ * The range is cut into chunks of -c days (default 1), taken in blocks.
+ * At the start of a block each worker is dealt an equal run of its
+ * chunks; it works from the front of its own run and, when that is
+ * empty, steals from the back of the longest remaining one.  Chunk
+ * results go to fixed slots, so the writer sees them in date order
+ * whatever thread made them; it writes one block while the workers fill
+ * the next.  Workers share nothing else: the kernels are pure, event
+ * searches keep their state in a struct moon_event_search, and timej()
+ * is reentrant.
+ *
+ * Each worker also formats its chunks, into output buffers that belong
+ * to the chunk slots and are reused from block to block, so memory does
+ * not grow with the range and the writer only calls write().  Numbers
+ * are formatted as scaled integers, not with printf().
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include "moontool.h"
+#include "moonevent.h"
+
+#define MAXTHREAD   64
+#define BLOCKCHUNKS 16              /* chunks per thread in a block */
+#define LINEMAX     96              /* longest CSV line */
+
+#define FMT_CSV     0
+#define FMT_BIN     1
+
+struct row {
+    double jd, phase, illum, age, dist, angdia;
+    short year;
+    unsigned char month, day, hour, min;
+};
+
+struct event {
+    double jd;
+    int kind;
+};
+
+static const char *event_name[] = { "new moon", "full moon", "perigee", "apogee" };
+
+struct chunk {
+    int nrows, nevents;
+    struct row *rows;
+    struct event *events;           /* 4 * drv.maxevent */
+    struct moon_event *scan;        /* drv.maxevent, for one kind */
+    char *out;                      /* formatted rows and events */
+    size_t outlen;
+};
+
+struct ephem_record {               /* -f bin, host byte order */
+    double jd;                      /* UT */
+    float phase, illum, age, dist, angdia;
+    uint32_t kind;                  /* 0 for samples, 1 + index into
+                                       event_name[] for events, whose
+                                       other fields are 0 */
+};
+
+/* chunk numbers of the current block not taken yet, [lo, hi) */
+struct deque {
+    pthread_mutex_t lock;
+    long lo, hi;
+};
+
+static struct {
+    double jd0, step;
+    long nrows;                     /* rows in the whole range */
+    int rows_per_chunk;
+    int maxevent;                   /* events of one kind in a chunk */
+    long nchunk;
+    int nthread, block;             /* threads; chunks per block */
+    int format;                     /* FMT_CSV or FMT_BIN */
+    long base;                      /* first chunk of the block computed */
+    struct chunk *slot;             /* the block being computed */
+    struct deque dq[MAXTHREAD];
+    int done;
+    pthread_barrier_t start, end;
+} drv;
+
+static int take(int w, long *c)
+{
+    struct deque *d = &drv.dq[w];
+    long best = 0;
+    int i, victim = -1, ok = 0;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->lo < d->hi)
+    {
+        *c = d->lo++;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    if (ok) return 1;
+
+    /* steal from the back of the longest run, rechecking under its lock */
+    for (;;)
+    {
+        best = 0;
+        victim = -1;
+        for (i = 0; i < drv.nthread; i++)
+        {
+            long left;
+
+            pthread_mutex_lock(&drv.dq[i].lock);
+            left = drv.dq[i].hi - drv.dq[i].lo;
+            pthread_mutex_unlock(&drv.dq[i].lock);
+            if (left > best)
+            {
+                best = left;
+                victim = i;
+            }
+        }
+        if (victim < 0) return 0;
+        d = &drv.dq[victim];
+        pthread_mutex_lock(&d->lock);
+        if (d->lo < d->hi)
+        {
+            *c = --d->hi;
+            ok = 1;
+        }
+        pthread_mutex_unlock(&d->lock);
+        if (ok) return 1;
+    }
+}
+
+static int cmp_event(const void *a, const void *b)
+{
+    double x = ((const struct event *) a)->jd, y = ((const struct event *) b)->jd;
+    return x < y ? -1 : x > y;
+}
+
+static void compute_chunk(long c, struct chunk *ch)
+{
+    static const struct { int channel, kind; double level; } kinds[] = {
+        { EV_PHASE, EV_RISING, 0 }, { EV_PHASE, EV_RISING, 0.5 },
+        { EV_DIST, EV_MINIMUM, 0 }, { EV_DIST, EV_MAXIMUM, 0 },
+    };
+    struct moon_event *ev = ch->scan;
+    struct moon_event_search s;
+    long first = c * drv.rows_per_chunk, i;
+    double a, b, sudist, suang;
+    struct tm t;
+    int k, n;
+
+    ch->nrows = 0;
+    for (i = first; i < first + drv.rows_per_chunk && i < drv.nrows; i++)
+    {
+        struct row *r = &ch->rows[ch->nrows++];
+
+        r->jd = drv.jd0 + i * drv.step;
+        r->phase = moon_phase(r->jd, &r->illum, &r->age, &r->dist, &r->angdia,
+                              &sudist, &suang);
+        t = timej(r->jd);
+        r->year = (short) (t.tm_year + 1900);
+        r->month = (unsigned char) (t.tm_mon + 1);
+        r->day = (unsigned char) t.tm_mday;
+        r->hour = (unsigned char) t.tm_hour;
+        r->min = (unsigned char) t.tm_min;
+    }
+
+    /* events in [a, b), bracketed on a grid from the start of the range,
+       so that neighbouring chunks refine an event near their common end
+       alike and exactly one of them keeps it */
+    a = drv.jd0 + first * drv.step;
+    b = drv.jd0 + i * drv.step;
+    ch->nevents = 0;
+    for (k = 0; k < 4; k++)
+    {
+        moon_event_init(&s, moon_phase, kinds[k].channel);
+        s.anchor = drv.jd0;
+        n = moon_event_scan(&s, kinds[k].kind, kinds[k].level, a, b, ev, drv.maxevent);
+        if (n < 0 || n == drv.maxevent)
+        {
+            fprintf(stderr, "ephem: %s search failed in chunk %ld\n",
+                    event_name[k], c);
+            exit(1);
+        }
+        while (n-- > 0)
+        {
+            ch->events[ch->nevents].jd = ev[n].jd;
+            ch->events[ch->nevents++].kind = k;
+        }
+    }
+    qsort(ch->events, ch->nevents, sizeof(ch->events[0]), cmp_event);
+}
+
+/* -------------------------------------------------------------------- */
+/*  Formatting                                                          */
+
+static const double pow10[] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+/*  v as exactly width digits, zero padded.  */
+static char *put_digits(char *p, unsigned long v, int width)
+{
+    char *e = p + width;
+
+    while (e > p)
+    {
+        *--e = (char) ('0' + v % 10);
+        v /= 10;
+    }
+    return p + width;
+}
+
+/*  v with decimals (at most 9) places, as printf("%.*f") but for ties,
+    which can round the other way.  */
+static char *put_fixed(char *p, double v, int decimals)
+{
+    uint64_t n, ip, scale = (uint64_t) pow10[decimals];
+    char tmp[20];
+    int k = 0;
+
+    if (v < 0)
+    {
+        *p++ = '-';
+        v = -v;
+    }
+    n = (uint64_t) (v * pow10[decimals] + 0.5);
+    ip = n / scale;
+    do
+    {
+        tmp[k++] = (char) ('0' + ip % 10);
+        ip /= 10;
+    } while (ip);
+    while (k) *p++ = tmp[--k];
+    if (decimals)
+    {
+        *p++ = '.';
+        p = put_digits(p, (unsigned long) (n % scale), decimals);
+    }
+    return p;
+}
+
+static char *put_string(char *p, const char *s)
+{
+    while (*s) *p++ = *s++;
+    return p;
+}
+
+/*  2024-01-11T12:00  */
+static char *put_time(char *p, int year, int month, int day, int hour, int min)
+{
+    p = put_digits(p, year, 4); *p++ = '-';
+    p = put_digits(p, month, 2); *p++ = '-';
+    p = put_digits(p, day, 2); *p++ = 'T';
+    p = put_digits(p, hour, 2); *p++ = ':';
+    return put_digits(p, min, 2);
+}
+
+static char *csv_row(char *p, const struct row *r)
+{
+    p = put_time(p, r->year, r->month, r->day, r->hour, r->min);
+    *p++ = ','; *p++ = ',';
+    p = put_fixed(p, r->phase, 6); *p++ = ',';
+    p = put_fixed(p, r->illum, 6); *p++ = ',';
+    p = put_fixed(p, r->age, 4); *p++ = ',';
+    p = put_fixed(p, r->dist, 1); *p++ = ',';
+    p = put_fixed(p, r->angdia, 5);
+    *p++ = '\n';
+    return p;
+}
+
+static char *csv_event(char *p, const struct event *e)
+{
+    struct tm t = timej(e->jd);
+
+    p = put_time(p, t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min);
+    *p++ = ':';
+    p = put_digits(p, t.tm_sec, 2);
+    *p++ = ',';
+    p = put_string(p, event_name[e->kind]);
+    return put_string(p, ",,,,,\n");
+}
+
+static char *bin_row(char *p, const struct row *r)
+{
+    struct ephem_record rec;
+
+    rec.jd = r->jd;
+    rec.phase = (float) r->phase;
+    rec.illum = (float) r->illum;
+    rec.age = (float) r->age;
+    rec.dist = (float) r->dist;
+    rec.angdia = (float) r->angdia;
+    rec.kind = 0;
+    memcpy(p, &rec, sizeof(rec));
+    return p + sizeof(rec);
+}
+
+static char *bin_event(char *p, const struct event *e)
+{
+    struct ephem_record rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.jd = e->jd;
+    rec.kind = (uint32_t) e->kind + 1;
+    memcpy(p, &rec, sizeof(rec));
+    return p + sizeof(rec);
+}
+
+/*  Rows and events of the chunk, merged in date order, into ch->out.  */
+static void format_chunk(struct chunk *ch)
+{
+    char *(*row)(char *, const struct row *) = drv.format == FMT_BIN ? bin_row : csv_row;
+    char *(*event)(char *, const struct event *) = drv.format == FMT_BIN ? bin_event : csv_event;
+    char *p = ch->out;
+    int i, j = 0;
+
+    for (i = 0; i < ch->nrows; i++)
+    {
+        for (; j < ch->nevents && ch->events[j].jd < ch->rows[i].jd; j++)
+            p = event(p, &ch->events[j]);
+        p = row(p, &ch->rows[i]);
+    }
+    for (; j < ch->nevents; j++)
+        p = event(p, &ch->events[j]);
+    ch->outlen = (size_t) (p - ch->out);
+}
+
+/* -------------------------------------------------------------------- */
+
+static void *worker(void *arg)
+{
+    int w = (int) (intptr_t) arg;
+    long c;
+
+    for (;;)
+    {
+        pthread_barrier_wait(&drv.start);
+        if (drv.done) return NULL;
+        while (take(w, &c))
+        {
+            compute_chunk(c, &drv.slot[c - drv.base]);
+            format_chunk(&drv.slot[c - drv.base]);
+        }
+        pthread_barrier_wait(&drv.end);
+    }
+}
+
+/* -------------------------------------------------------------------- */
+/*  Output                                                              */
+
+struct output {
+    int fd;                         /* -1: checksum only */
+    uint64_t hash;
+    long rows, events;
+    uint64_t bytes;
+};
+
+/*  FNV-1a over 64-bit words, then the tail bytes.  */
+static void hash_bytes(struct output *o, const char *p, size_t n)
+{
+    uint64_t w;
+
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        memcpy(&w, p, 8);
+        o->hash = (o->hash ^ w) * 0x100000001b3ULL;
+    }
+    while (n--) o->hash = (o->hash ^ (unsigned char) *p++) * 0x100000001b3ULL;
+}
+
+static void write_all(struct output *o, const char *p, size_t n)
+{
+    ssize_t w;
+
+    hash_bytes(o, p, n);
+    o->bytes += n;
+    while (o->fd >= 0 && n > 0)
+    {
+        w = write(o->fd, p, n);
+        if (w < 0)
+        {
+            perror("ephem: write");
+            exit(1);
+        }
+        p += w;
+        n -= (size_t) w;
+    }
+}
+
+static void write_chunk(struct output *o, const struct chunk *ch)
+{
+    o->rows += ch->nrows;
+    o->events += ch->nevents;
+    write_all(o, ch->out, ch->outlen);
+}
+
+/* -------------------------------------------------------------------- */
+
+/*  Generate the range on nthread threads into o.  */
+static void run(double jd0, double jd1, double step, int chunk_days, int nthread,
+                int format, struct output *o)
+{
+    pthread_t tid[MAXTHREAD];
+    struct chunk *buf[2];
+    struct row *rows[2];
+    struct event *events[2];
+    struct moon_event *scan[2];
+    char *out[2];
+    size_t outmax;
+    long b, nblock, c0, c1, n;
+    int i, cur = 0;
+
+    drv.jd0 = jd0;
+    drv.step = step;
+    drv.nrows = (long) ceil((jd1 - jd0) / step);
+    drv.rows_per_chunk = (int) ceil(chunk_days / step);
+    /* perigees can come 24.5 days apart, lunations 29.3; one spare for
+       the chunk edges, one so a full buffer means more than fitted */
+    drv.maxevent = chunk_days / 24 + 2;
+    drv.nchunk = (drv.nrows + drv.rows_per_chunk - 1) / drv.rows_per_chunk;
+    drv.nthread = nthread;
+    drv.block = nthread * BLOCKCHUNKS;
+    drv.format = format;
+    drv.done = 0;
+    outmax = (size_t) (drv.rows_per_chunk + 4 * drv.maxevent) *
+             (format == FMT_BIN ? sizeof(struct ephem_record) : LINEMAX);
+    for (i = 0; i < 2; i++)
+    {
+        buf[i] = calloc(drv.block, sizeof(struct chunk));
+        rows[i] = malloc((size_t) drv.block * drv.rows_per_chunk * sizeof(struct row));
+        events[i] = malloc((size_t) drv.block * 4 * drv.maxevent * sizeof(struct event));
+        scan[i] = malloc((size_t) drv.block * drv.maxevent * sizeof(struct moon_event));
+        out[i] = malloc(drv.block * outmax);
+        if (!buf[i] || !rows[i] || !events[i] || !scan[i] || !out[i])
+        {
+            fprintf(stderr, "ephem: out of memory\n");
+            exit(1);
+        }
+        for (c0 = 0; c0 < drv.block; c0++)
+        {
+            buf[i][c0].rows = rows[i] + c0 * drv.rows_per_chunk;
+            buf[i][c0].events = events[i] + c0 * 4 * drv.maxevent;
+            buf[i][c0].scan = scan[i] + c0 * drv.maxevent;
+            buf[i][c0].out = out[i] + c0 * outmax;
+        }
+    }
+    for (i = 0; i < nthread; i++) pthread_mutex_init(&drv.dq[i].lock, NULL);
+    pthread_barrier_init(&drv.start, NULL, nthread + 1);
+    pthread_barrier_init(&drv.end, NULL, nthread + 1);
+    for (i = 0; i < nthread; i++)
+        pthread_create(&tid[i], NULL, worker, (void *) (intptr_t) i);
+
+    nblock = (drv.nchunk + drv.block - 1) / drv.block;
+    for (b = 0; b <= nblock; b++)
+    {
+        if (b < nblock)
+        {
+            /* deal out the block, then write the previous one meanwhile */
+            c0 = b * drv.block;
+            c1 = c0 + drv.block < drv.nchunk ? c0 + drv.block : drv.nchunk;
+            n = c1 - c0;
+            drv.base = c0;
+            drv.slot = buf[cur];
+            for (i = 0; i < nthread; i++)
+            {
+                drv.dq[i].lo = c0 + n * i / nthread;
+                drv.dq[i].hi = c0 + n * (i + 1) / nthread;
+            }
+            pthread_barrier_wait(&drv.start);
+        }
+        if (b > 0)
+        {
+            struct chunk *prev = buf[1 - cur];
+            c0 = (b - 1) * drv.block;
+            c1 = c0 + drv.block < drv.nchunk ? c0 + drv.block : drv.nchunk;
+            for (n = 0; n < c1 - c0; n++) write_chunk(o, &prev[n]);
+        }
+        if (b < nblock)
+        {
+            pthread_barrier_wait(&drv.end);
+            cur = 1 - cur;
+        }
+    }
+
+    drv.done = 1;
+    pthread_barrier_wait(&drv.start);
+    for (i = 0; i < nthread; i++) pthread_join(tid[i], NULL);
+    pthread_barrier_destroy(&drv.start);
+    pthread_barrier_destroy(&drv.end);
+    for (i = 0; i < nthread; i++) pthread_mutex_destroy(&drv.dq[i].lock);
+    for (i = 0; i < 2; i++)
+    {
+        free(out[i]);
+        free(scan[i]);
+        free(events[i]);
+        free(rows[i]);
+        free(buf[i]);
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/*  Time the CSV formatter against snprintf() on n rows, and count the
+    lines where they differ (ties rounded the other way).  */
+static void format_bench(double jd0, double step)
+{
+    enum { N = 200000 };
+    static struct row r[N];
+    static char line[LINEMAX], ref[LINEMAX];
+    double sudist, suang, t0, tfmt, tprintf;
+    long i, differ = 0;
+    size_t len = 0;
+    struct tm t;
+
+    for (i = 0; i < N; i++)
+    {
+        r[i].jd = jd0 + i * step;
+        r[i].phase = moon_phase(r[i].jd, &r[i].illum, &r[i].age, &r[i].dist,
+                                &r[i].angdia, &sudist, &suang);
+        t = timej(r[i].jd);
+        r[i].year = (short) (t.tm_year + 1900);
+        r[i].month = (unsigned char) (t.tm_mon + 1);
+        r[i].day = (unsigned char) t.tm_mday;
+        r[i].hour = (unsigned char) t.tm_hour;
+        r[i].min = (unsigned char) t.tm_min;
+    }
+    t0 = now();
+    for (i = 0; i < N; i++) len += (size_t) (csv_row(line, &r[i]) - line);
+    tfmt = now() - t0;
+    t0 = now();
+    for (i = 0; i < N; i++)
+        len += (size_t) snprintf(ref, sizeof(ref),
+                "%04d-%02d-%02dT%02d:%02d,,%.6f,%.6f,%.4f,%.1f,%.5f\n",
+                r[i].year, r[i].month, r[i].day, r[i].hour, r[i].min,
+                r[i].phase, r[i].illum, r[i].age, r[i].dist, r[i].angdia);
+    tprintf = now() - t0;
+    for (i = 0; i < N; i++)
+    {
+        *csv_row(line, &r[i]) = 0;
+        snprintf(ref, sizeof(ref), "%04d-%02d-%02dT%02d:%02d,,%.6f,%.6f,%.4f,%.1f,%.5f\n",
+                 r[i].year, r[i].month, r[i].day, r[i].hour, r[i].min,
+                 r[i].phase, r[i].illum, r[i].age, r[i].dist, r[i].angdia);
+        differ += strcmp(line, ref) != 0;
+    }
+    printf("ephem: csv formatting %.3g rows/s, snprintf %.3g rows/s, %.1f bytes a line, "
+           "%ld of %d lines differ\n", N / tfmt, N / tprintf, len / (2.0 * N), differ, N);
+}
+
+int main(int argc, char *argv[])
+{
+    struct output o;
+    int opt, nthread = 0, minutes = 1, chunk_days = 1, bench = 0, t;
+    int format = FMT_CSV;
+    const char *path = NULL;
+    double jd0, jd1, t0, rate1 = 0, rate;
+    uint64_t hash1 = 0;
+
+    while ((opt = getopt(argc, argv, "Bj:m:c:f:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'B': bench = 1; break;
+        case 'j': nthread = atoi(optarg); break;
+        case 'm': minutes = atoi(optarg); break;
+        case 'c': chunk_days = atoi(optarg); break;
+        case 'f': format = strcmp(optarg, "bin") == 0 ? FMT_BIN :
+                           strcmp(optarg, "csv") == 0 ? FMT_CSV : -1; break;
+        case 'o': path = optarg; break;
+        default: optind = argc + 1;
+        }
+    }
+    if (optind + 2 != argc || minutes < 1 || chunk_days < 1 || nthread < 0 ||
+        nthread > MAXTHREAD || format < 0)
+    {
+        fprintf(stderr, "usage: ephem [-B] [-j threads] [-m minutes] [-c days] "
+                        "[-f csv|bin] [-o file] first_year last_year\n");
+        return 2;
+    }
+    jd0 = days_from_civil(atoi(argv[optind]), 1, 1) + 2440587.5;
+    jd1 = days_from_civil(atoi(argv[optind + 1]) + 1, 1, 1) + 2440587.5;
+
+    if (!bench)
+    {
+        memset(&o, 0, sizeof(o));
+        o.fd = path ? open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : 1;
+        if (o.fd < 0)
+        {
+            perror(path);
+            return 1;
+        }
+        if (format == FMT_BIN)
+        {
+            char head[16] = "LUNAEPH1";
+            uint32_t v[2] = { sizeof(struct ephem_record), (uint32_t) minutes * 60 };
+            memcpy(head + 8, v, sizeof(v));
+            write_all(&o, head, sizeof(head));
+        } else
+        {
+            static const char head[] = "time,event,phase,illum,age,dist,angdia\n";
+            write_all(&o, head, sizeof(head) - 1);
+        }
+        run(jd0, jd1, minutes / 1440.0, chunk_days, nthread ? nthread : 1, format, &o);
+        if (path) close(o.fd);
+        return 0;
+    }
+
+    if (!nthread) nthread = 4;
+    printf("ephem: %ld cores online, %s to %s every %d min, %s\n",
+           sysconf(_SC_NPROCESSORS_ONLN), argv[optind], argv[optind + 1], minutes,
+           format == FMT_BIN ? "binary" : "csv");
+    format_bench(jd0, minutes / 1440.0);
+    for (t = 1; t <= nthread; t *= 2)
+    {
+        memset(&o, 0, sizeof(o));
+        o.fd = -1;
+        o.hash = 0xcbf29ce484222325ULL;
+        t0 = now();
+        run(jd0, jd1, minutes / 1440.0, chunk_days, t, format, &o);
+        rate = o.rows / (now() - t0);
+        if (t == 1)
+        {
+            rate1 = rate;
+            hash1 = o.hash;
+        }
+        printf("ephem: %2d threads %10.3g rows/s, speedup %5.2f, %ld rows, "
+               "%ld events, %.0f MB, output %s\n", t, rate, rate / rate1, o.rows,
+               o.events, o.bytes / 1e6, o.hash == hash1 ? "identical" : "DIFFERS");
+        if (t < nthread && 2 * t > nthread) t = nthread / 2;
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * ephfile - precomputed ephemeris files, read through mmap()
+ *
+ * Files are written by ephgen.  A lookup is an index computation, one
+ * 48 byte read of two neighbouring samples and a cubic Hermite
+ * polynomial in the fraction of a step, so its cost is that of bringing
+ * the samples in from the page cache; no trigonometry is evaluated.
+ * Events are found through the day index, which points at the first
+ * event of each day, so the search for the next one is a short scan.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <math.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ephfile.h"
+
+/*  Map path and check that it is an ephemeris this code can read.
+    Returns NULL, or why not.  */
+const char *eph_open(struct eph_file *f, const char *path)
+{
+    const struct eph_header *h;
+    struct stat st;
+    const char *err = NULL;
+    int fd;
+
+    memset(f, 0, sizeof(*f));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return "cannot open";
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(struct eph_header))
+    {
+        close(fd);
+        return "too short";
+    }
+    f->size = (size_t) st.st_size;
+    f->map = mmap(NULL, f->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (f->map == MAP_FAILED)
+    {
+        f->map = NULL;
+        return "cannot map";
+    }
+
+    h = f->h = f->map;
+    if (memcmp(h->magic, EPH_MAGIC, sizeof(h->magic)) != 0)
+        err = "not an ephemeris file";
+    else if (h->order != EPH_ORDER)
+        err = "written with the other byte order";
+    else if (h->version != EPH_VERSION)
+        err = "unknown version";
+    else if (h->header_size != sizeof(struct eph_header) ||
+             h->sample_size != sizeof(struct eph_sample) ||
+             h->event_size != sizeof(struct eph_event))
+        err = "record sizes differ";
+    else if (h->nsample < 2 || h->step <= 0 ||
+             h->sample_offset + h->nsample * sizeof(struct eph_sample) > f->size ||
+             h->event_offset + h->nevent * sizeof(struct eph_event) > f->size ||
+             h->day_offset + (h->nday + 1) * sizeof(uint64_t) > f->size)
+        err = "truncated";
+    if (err)
+    {
+        eph_close(f);
+        return err;
+    }
+    f->sample = (const struct eph_sample *) ((const char *) f->map + h->sample_offset);
+    f->event = (const struct eph_event *) ((const char *) f->map + h->event_offset);
+    f->day = (const uint64_t *) ((const char *) f->map + h->day_offset);
+    return NULL;
+}
+
+void eph_close(struct eph_file *f)
+{
+    if (f->map) munmap(f->map, f->size);
+    memset(f, 0, sizeof(*f));
+}
+
+/*  Cubic Hermite between v0 and v1 with changes d0, d1 per step, at
+    fraction t of the step.  */
+static inline double hermite(double t, double v0, double d0, double v1, double d1)
+{
+    double t2 = t * t, t3 = t2 * t;
+
+    return (2 * t3 - 3 * t2 + 1) * v0 + (t3 - 2 * t2 + t) * d0 +
+           (3 * t2 - 2 * t3) * v1 + (t3 - t2) * d1;
+}
+
+/*  Phase, illuminated fraction and distance at jd.  Returns 0, or -1 if
+    jd is outside the file, leaving the outputs alone.  */
+int eph_lookup(const struct eph_file *f, double jd, double *phase,
+        double *illum, double *dist)
+{
+    const struct eph_sample *s;
+    double x = (jd - f->h->jd0) / f->h->step, t, p1, p;
+    uint64_t i;
+
+    if (!(x >= 0) || x > (double) (f->h->nsample - 1)) return -1;
+    i = (uint64_t) x;
+    if (i == f->h->nsample - 1) i--;
+    t = x - (double) i;
+    s = &f->sample[i];
+
+    p1 = s[1].phase;
+    if (p1 < s[0].phase) p1 += 1;
+    p = hermite(t, s[0].phase, s[0].dphase, p1, s[1].dphase);
+    if (phase) *phase = p - floor(p);
+    if (illum) *illum = hermite(t, s[0].illum, s[0].dillum, s[1].illum, s[1].dillum);
+    if (dist) *dist = hermite(t, s[0].dist, s[0].ddist, s[1].dist, s[1].ddist);
+    return 0;
+}
+
+/*  First event of kind (or EPH_ANY) at or after jd, NULL if none in the
+    file.  */
+const struct eph_event *eph_next_event(const struct eph_file *f, double jd,
+        int kind)
+{
+    const struct eph_event *e, *end = f->event + f->h->nevent;
+    double x = floor(jd - f->h->jd0);
+
+    if (x < 0) e = f->event;
+    else if (x >= (double) f->h->nday) return NULL;
+    else e = f->event + f->day[(uint64_t) x];
+    for (; e < end; e++)
+        if (e->jd >= jd && (kind == EPH_ANY || e->kind == (uint32_t) kind))
+            return e;
+    return NULL;
+}
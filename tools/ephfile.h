@@ -0,0 +1,71 @@
+/*
+ * ephfile - precomputed ephemeris files, read through mmap()
+ *
+ * A file is a struct eph_header, then nsample struct eph_sample taken
+ * every step days from jd0, then nevent struct eph_event in date order,
+ * then nday + 1 event numbers: day[d] is the first event at or after
+ * jd0 + d.  All in host byte order; the header's order field tells.
+ */
+
+#ifndef EPHFILE_H
+#define EPHFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EPH_MAGIC   "LUNAIDX"       /* with its terminator, 8 bytes */
+#define EPH_VERSION 1
+#define EPH_ORDER   0x01020304u
+
+#define EPH_NEW     0               /* event kinds */
+#define EPH_FIRST   1               /* first quarter */
+#define EPH_FULL    2
+#define EPH_LAST    3               /* last quarter */
+#define EPH_PERIGEE 4
+#define EPH_APOGEE  5
+#define EPH_NKIND   6
+#define EPH_ANY     (-1)
+
+struct eph_header {
+    char magic[8];                  /* EPH_MAGIC */
+    uint32_t version;               /* EPH_VERSION */
+    uint32_t order;                 /* EPH_ORDER as written */
+    uint32_t kernel;                /* LUNA_KERNEL of the generator */
+    uint32_t header_size, sample_size, event_size;
+    double jd0;                     /* first sample, UT */
+    double step;                    /* days between samples */
+    uint64_t nsample, nevent, nday;
+    uint64_t sample_offset, event_offset, day_offset;  /* bytes */
+};
+
+/*  Values at a sample and their changes per step, for Hermite
+    interpolation.  The phase change is unwrapped across new moon.  */
+struct eph_sample {
+    float phase, dphase;
+    float illum, dillum;
+    float dist, ddist;              /* km */
+};
+
+struct eph_event {
+    double jd;                      /* UT */
+    float value;                    /* distance in km, 0 for phases */
+    uint32_t kind;                  /* EPH_NEW ... EPH_APOGEE */
+};
+
+struct eph_file {
+    const struct eph_header *h;
+    const struct eph_sample *sample;
+    const struct eph_event *event;
+    const uint64_t *day;
+    void *map;
+    size_t size;
+};
+
+const char *eph_open(struct eph_file *f, const char *path);
+void eph_close(struct eph_file *f);
+int eph_lookup(const struct eph_file *f, double jd, double *phase,
+        double *illum, double *dist);
+const struct eph_event *eph_next_event(const struct eph_file *f, double jd,
+        int kind);
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * ephgen - write and measure precomputed ephemeris files
+ *
+ * usage: ephgen [-s hours] -o file first_year last_year
+ *        ephgen -B file
+ *
+ * Samples moon_phase() as built (see LUNA_KERNEL) every -s hours
+ * (default 6) from the start of first_year to the end of last_year,
+ * with the change of each value over a step taken by central
+ * differences, finds the phases, perigees and apogees, and writes them
+ * in the format of ephfile.h.  -B maps an existing file and times
+ * eph_lookup() and eph_next_event() at random dates against moon_phase(),
+ * reporting the largest interpolation errors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "moontool.h"
+#include "moonconst.h"
+#include "moonevent.h"
+#include "ephfile.h"
+
+#define DIFF (1.0 / 1440)           /* half width of the difference, days */
+
+static volatile double sink;        /* keeps the timed loops */
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cmp_event(const void *a, const void *b)
+{
+    double x = ((const struct eph_event *) a)->jd, y = ((const struct eph_event *) b)->jd;
+    return x < y ? -1 : x > y;
+}
+
+static int generate(const char *path, double jd0, double jd1, double step)
+{
+    static const struct { int channel, kind; double level; } kinds[EPH_NKIND] = {
+        { EV_PHASE, EV_RISING, 0 }, { EV_PHASE, EV_RISING, 0.25 },
+        { EV_PHASE, EV_RISING, 0.5 }, { EV_PHASE, EV_RISING, 0.75 },
+        { EV_DIST, EV_MINIMUM, 0 }, { EV_DIST, EV_MAXIMUM, 0 },
+    };
+    struct eph_header h;
+    struct eph_sample *sample;
+    struct eph_event *event;
+    struct moon_event *found;
+    struct moon_event_search s;
+    uint64_t *day, i, d;
+    double illum[3], dist[3], phase[3], dp, age, angdia, sudist, suang;
+    int k, n, maxfound;
+    FILE *f;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, EPH_MAGIC, sizeof(h.magic));
+    h.version = EPH_VERSION;
+    h.order = EPH_ORDER;
+    h.kernel = LUNA_KERNEL;
+    h.header_size = sizeof(struct eph_header);
+    h.sample_size = sizeof(struct eph_sample);
+    h.event_size = sizeof(struct eph_event);
+    h.jd0 = jd0;
+    h.step = step;
+    h.nsample = (uint64_t) ceil((jd1 - jd0) / step) + 1;
+    h.nday = (uint64_t) ceil((h.nsample - 1) * step);
+
+    maxfound = (int) ((jd1 - jd0) / 25) + 8;
+    sample = malloc(h.nsample * sizeof(*sample));
+    event = malloc((size_t) EPH_NKIND * maxfound * sizeof(*event));
+    found = malloc((size_t) maxfound * sizeof(*found));
+    day = malloc((h.nday + 1) * sizeof(*day));
+    if (!sample || !event || !found || !day)
+    {
+        fprintf(stderr, "ephgen: out of memory\n");
+        return 1;
+    }
+
+    for (i = 0; i < h.nsample; i++)
+    {
+        double jd = jd0 + i * step;
+
+        for (k = 0; k < 3; k++)
+            phase[k] = moon_phase(jd + (k - 1) * DIFF, &illum[k], &age, &dist[k],
+                                  &angdia, &sudist, &suang);
+        dp = phase[2] - phase[0];
+        if (dp < 0) dp += 1;
+        sample[i].phase = (float) phase[1];
+        sample[i].dphase = (float) (dp * step / (2 * DIFF));
+        sample[i].illum = (float) illum[1];
+        sample[i].dillum = (float) ((illum[2] - illum[0]) * step / (2 * DIFF));
+        sample[i].dist = (float) dist[1];
+        sample[i].ddist = (float) ((dist[2] - dist[0]) * step / (2 * DIFF));
+    }
+
+    for (k = 0; k < EPH_NKIND; k++)
+    {
+        moon_event_init(&s, moon_phase, kinds[k].channel);
+        n = moon_event_scan(&s, kinds[k].kind, kinds[k].level, jd0,
+                            jd0 + (h.nsample - 1) * step, found, maxfound);
+        if (n < 0 || n == maxfound)
+        {
+            fprintf(stderr, "ephgen: %s search for event kind %d\n",
+                    n < 0 ? "failed" : "overflowed", k);
+            return 1;
+        }
+        while (n-- > 0)
+        {
+            struct eph_event *e = &event[h.nevent++];
+
+            e->jd = found[n].jd;
+            e->value = kinds[k].channel == EV_DIST ? (float) found[n].value : 0;
+            e->kind = (uint32_t) k;
+        }
+    }
+    qsort(event, h.nevent, sizeof(*event), cmp_event);
+    for (d = 0, i = 0; d <= h.nday; d++)
+    {
+        while (i < h.nevent && event[i].jd < jd0 + d) i++;
+        day[d] = i;
+    }
+
+    h.sample_offset = sizeof(h);
+    h.event_offset = h.sample_offset + h.nsample * sizeof(*sample);
+    h.day_offset = h.event_offset + h.nevent * sizeof(*event);
+
+    f = fopen(path, "wb");
+    if (!f || fwrite(&h, sizeof(h), 1, f) != 1 ||
+        fwrite(sample, sizeof(*sample), h.nsample, f) != h.nsample ||
+        fwrite(event, sizeof(*event), h.nevent, f) != h.nevent ||
+        fwrite(day, sizeof(*day), h.nday + 1, f) != h.nday + 1 || fclose(f) != 0)
+    {
+        perror(path);
+        return 1;
+    }
+    printf("ephgen: %s: %llu samples every %g h, %llu events, %llu bytes\n", path,
+           (unsigned long long) h.nsample, step * 24, (unsigned long long) h.nevent,
+           (unsigned long long) h.day_offset + (h.nday + 1) * sizeof(*day));
+    free(day);
+    free(found);
+    free(event);
+    free(sample);
+    return 0;
+}
+
+/*  xorshift64*, uniform in [0, 1)  */
+static double uniform(uint64_t *x)
+{
+    *x ^= *x >> 12;
+    *x ^= *x << 25;
+    *x ^= *x >> 27;
+    return (double) ((*x * 2685821657736338717ULL) >> 11) * 0x1p-53;
+}
+
+static int bench(const char *path)
+{
+    enum { N = 1000000, NCHECK = 200000 };
+    struct eph_file f;
+    const struct eph_event *e;
+    const char *err;
+    double *jd, span, sum = 0, t0, tlook, tkern, tevent;
+    double p, il, di, p2, il2, di2, age, angdia, sudist, suang, dp;
+    double maxp = 0, maxi = 0, maxd = 0;
+    uint64_t x = 88172645463325252ULL;
+    long i, missing = 0;
+
+    err = eph_open(&f, path);
+    if (err)
+    {
+        fprintf(stderr, "ephgen: %s: %s\n", path, err);
+        return 1;
+    }
+    jd = malloc(N * sizeof(*jd));
+    if (!jd)
+    {
+        fprintf(stderr, "ephgen: out of memory\n");
+        return 1;
+    }
+    span = (f.h->nsample - 1) * f.h->step;
+    for (i = 0; i < N; i++) jd[i] = f.h->jd0 + uniform(&x) * span;
+    printf("ephgen: %s: %.1f MB, %llu samples every %g h, %llu events, kernel %u\n",
+           path, f.size / 1e6, (unsigned long long) f.h->nsample, f.h->step * 24,
+           (unsigned long long) f.h->nevent, f.h->kernel);
+
+    /* the first pass brings the file into the page cache */
+    for (i = 0; i < N; i++)
+        if (eph_lookup(&f, jd[i], &p, &il, &di) == 0) sum += p + il + di;
+    t0 = now();
+    for (i = 0; i < N; i++)
+        if (eph_lookup(&f, jd[i], &p, &il, &di) == 0) sum += p + il + di;
+    tlook = now() - t0;
+    t0 = now();
+    for (i = 0; i < N; i++)
+        sum += moon_phase(jd[i], &il, &age, &di, &angdia, &sudist, &suang) + il + di;
+    tkern = now() - t0;
+    t0 = now();
+    for (i = 0; i < N; i++)
+    {
+        e = eph_next_event(&f, jd[i], (int) (i % EPH_NKIND));
+        if (e) sum += e->jd;
+        else missing++;
+    }
+    tevent = now() - t0;
+    printf("ephgen: random dates: eph_lookup %.1f ns, moon_phase %.1f ns, "
+           "eph_next_event %.1f ns (%ld past the end)\n", tlook / N * 1e9,
+           tkern / N * 1e9, tevent / N * 1e9, missing);
+    sink = sum;
+
+    if (f.h->kernel != LUNA_KERNEL)
+        printf("ephgen: file made with kernel %u, errors are against kernel %d\n",
+               f.h->kernel, LUNA_KERNEL);
+    for (i = 0; i < NCHECK; i++)
+    {
+        eph_lookup(&f, jd[i], &p, &il, &di);
+        p2 = moon_phase(jd[i], &il2, &age, &di2, &angdia, &sudist, &suang);
+        dp = fabs(p - p2);
+        if (dp > 0.5) dp = 1 - dp;
+        if (dp > maxp) maxp = dp;
+        if (fabs(il - il2) > maxi) maxi = fabs(il - il2);
+        if (fabs(di - di2) > maxd) maxd = fabs(di - di2);
+    }
+    printf("ephgen: largest errors over %d dates: phase %.2f s, illuminated "
+           "fraction %.2g, distance %.3f km\n", NCHECK, maxp * SYNMONTH * 86400,
+           maxi, maxd);
+    free(jd);
+    eph_close(&f);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct tm start = { .tm_mday = 1 };
+    const char *path = NULL;
+    double hours = 6, jd0, jd1;
+    int i;
+
+    if (argc == 3 && strcmp(argv[1], "-B") == 0)
+        return bench(argv[2]);
+    for (i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-s") == 0) hours = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-o") == 0) path = argv[i + 1];
+        else break;
+    }
+    if (i + 2 != argc || !path || hours <= 0)
+    {
+        fprintf(stderr, "usage: ephgen [-s hours] -o file first_year last_year\n"
+                        "       ephgen -B file\n");
+        return 2;
+    }
+    start.tm_year = atoi(argv[i]) - 1900;
+    jd0 = jtime(&start);
+    start.tm_year = atoi(argv[i + 1]) + 1 - 1900;
+    jd1 = jtime(&start);
+    if (jd1 <= jd0)
+    {
+        fprintf(stderr, "ephgen: empty range\n");
+        return 2;
+    }
+    return generate(path, jd0, jd1, hours / 24);
+}
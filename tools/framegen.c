@@ -0,0 +1,952 @@
+/*
+ * framegen - build the moon frame set, src/luna_jpeg.bin and src/lunaindex.c
+ *
+ * usage: framegen [-i list | -x dir] [-n frames] [-r size] [-q quality,...]
+ *                 [-R restart,...] [-m baseline|abbrev|raw|rle|qoi|delta,...]
+ *                 [-K keys] [-t tolerance] [-o dir]
+ *        framegen -e dir
+ *
+ * The source is a sequence of greyscale frames: by default the ones
+ * this tool was linked with, decoded, or with -i a list
+ * of "phase file.pgm" lines, paths relative to the list.  -x writes the
+ * built in frames to dir as PGM files and such a list, to edit or
+ * replace.
+ *
+ * -n frames are picked from the source nearest to evenly spaced phases,
+ * scaled to -r pixels square (a multiple of 8, default 240) and encoded
+ * for each combination of -q JPEG quality (default 50), -R restart
+ * interval in blocks (default 0, none) and -m mode: "baseline" frames
+ * are whole JPEG files with Huffman tables fitted to each, "abbrev"
+ * frames leave out the quantiser and Huffman tables, which are fitted
+ * to the whole set and stored once ahead of the frames.  "raw", "rle"
+ * and "qoi" are the faster to decode codings of lunaframes.h, which take
+ * no quality or restart interval; rle keeps 4 bits of grey, the others
+ * all 8.  "delta" has a qoi key frame every -K frames (default 8) and in
+ * between codes only the 8x8 blocks that differ by more than -t grey
+ * levels (default 0) from the frame before as decoded; its decode time
+ * is that of a step from the frame before.  Every combination is
+ * decoded, with picojpeg or luna_unpack(), and reported with its size,
+ * decode time per frame, PSNR against the scaled source and a checksum;
+ * -o writes luna_jpeg.bin, its index lunaindex.c and both as the
+ * external data container luna_frames.dat (see lunaframes.h) to dir for
+ * the single combination given.  -e writes the same for the linked
+ * frames, unchanged.  The output depends only on
+ * the source and the options.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "picojpeg.h"
+#include "jpegenc.h"
+#include "lunaframes.h"
+
+#define MAXFRAME    256
+#define MAXCONF     16              /* values per option list */
+#define MAXBUCKET   4096
+
+#define MODE_BASELINE 0
+#define MODE_ABBREV   1
+#define MODE_RAW      2
+#define MODE_RLE      3
+#define MODE_QOI      4
+#define MODE_DELTA    5
+#define NMODE         6
+
+static const char *mode_name[] = { "baseline", "abbrev", "raw", "rle", "qoi", "delta" };
+static const int mode_codec[] = {
+    LUNA_CODEC_JPEG, LUNA_CODEC_JPEG, LUNA_CODEC_RAW, LUNA_CODEC_RLE, LUNA_CODEC_QOI,
+    LUNA_CODEC_DELTA
+};
+static const char *codec_name[] = {
+    "LUNA_CODEC_JPEG", "LUNA_CODEC_RAW", "LUNA_CODEC_RLE", "LUNA_CODEC_QOI",
+    "LUNA_CODEC_DELTA"
+};
+
+struct frame {
+    float phase;
+    int w, h;
+    uint8_t *pix;
+};
+
+/*  An encoded set: tables (abbrev only), then the frames back to back.  */
+struct frameset {
+    int codec;
+    uint8_t *tables, *data;
+    size_t ntables, ndata;
+    size_t offset[MAXFRAME + 1];
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *xmalloc(size_t n)
+{
+    void *p = malloc(n);
+
+    if (!p)
+    {
+        fprintf(stderr, "framegen: out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+/* -------------------------------------------------------------------- */
+/*  Decoding with picojpeg                                              */
+
+/*  Bytes for picojpeg: the tables, if any, then the frame.  */
+struct feed {
+    const uint8_t *tables, *data;
+    size_t ntables, ndata, pos;
+};
+
+static unsigned char need_bytes(unsigned char *buf, unsigned char size,
+        unsigned char *got, void *arg)
+{
+    struct feed *f = arg;
+    size_t n = size;
+
+    if (f->pos < f->ntables)
+    {
+        if (n > f->ntables - f->pos) n = f->ntables - f->pos;
+        memcpy(buf, f->tables + f->pos, n);
+    } else
+    {
+        if (n > f->ntables + f->ndata - f->pos) n = f->ntables + f->ndata - f->pos;
+        memcpy(buf, f->data + (f->pos - f->ntables), n);
+    }
+    f->pos += n;
+    *got = (unsigned char) n;
+    return 0;
+}
+
+/*  Decode into pix (may be NULL to just decode), which must hold w * h
+    bytes once the header is known; returns 0 or a picojpeg status.  */
+static int decode(const uint8_t *tables, size_t ntables, const uint8_t *data,
+        size_t ndata, uint8_t *pix, int *w, int *h)
+{
+    struct feed f = { tables, data, ntables, ndata, 0 };
+    pjpeg_image_info_t info;
+    int status, mx = 0, my = 0, x, y;
+
+    status = pjpeg_decode_init(&info, need_bytes, &f, 0);
+    if (status) return status;
+    if (info.m_scanType != PJPG_GRAYSCALE) return PJPG_UNSUPPORTED_COLORSPACE;
+    if (w) *w = info.m_width;
+    if (h) *h = info.m_height;
+    while ((status = pjpeg_decode_mcu()) == 0)
+    {
+        if (pix)
+            for (y = 0; y < 8; y++)
+                for (x = 0; x < 8; x++)
+                    if (my * 8 + y < info.m_height && mx * 8 + x < info.m_width)
+                        pix[(my * 8 + y) * info.m_width + mx * 8 + x] =
+                            info.m_pMCUBufR[y * 8 + x];
+        if (++mx == info.m_MCUSPerRow)
+        {
+            mx = 0;
+            my++;
+        }
+    }
+    return status == PJPG_NO_MORE_BLOCKS ? 0 : status;
+}
+
+/*  Unpack a frame in one of the other codings into npix grey pixels, as
+    the app does but through a table that leaves grey as it is; returns
+    0 or -1 if the data runs short or is left over.  */
+static int unpack(int codec, const uint8_t *data, size_t ndata, uint8_t *pix, int npix)
+{
+    static uint16_t grey[256], out[4096];
+    struct luna_unpack u;
+    int i, k, n;
+
+    for (i = 0; i < 256; i++) grey[i] = (uint16_t) i;
+    luna_unpack_init(&u, codec, data, ndata);
+    for (k = 0; k < npix; k += n)
+    {
+        n = npix - k < 4096 ? npix - k : 4096;
+        if (luna_unpack(&u, grey, out, n) != n) return -1;
+        if (pix)
+            for (i = 0; i < n; i++) pix[k + i] = (uint8_t) out[i];
+    }
+    return u.p == u.end && u.run == 0 ? 0 : -1;
+}
+
+/* -------------------------------------------------------------------- */
+/*  Sources                                                             */
+
+/*  The frames linked in from src/luna_jpeg.bin.  */
+static int builtin_frames(struct frame *fr)
+{
+    const struct luna_frames *lf = &luna_frames;
+    int i, w, h;
+
+    for (i = 0; i < lf->nframe; i++)
+    {
+        const struct luna_frame *f = &lf->frame[i];
+        const uint8_t *p = lf->data + f->offset;
+
+        w = f->width;
+        h = f->height;
+        if (!luna_frame_ok(lf, i) || (lf->codec == LUNA_CODEC_JPEG &&
+            (decode(lf->data, lf->tables_len, p, f->length, NULL, &w, &h) ||
+             w != f->width || h != f->height)))
+        {
+            fprintf(stderr, "framegen: built in frame %d is damaged\n", i);
+            exit(1);
+        }
+        fr[i].phase = f->phase;
+        fr[i].w = w;
+        fr[i].h = h;
+        fr[i].pix = xmalloc((size_t) w * h);
+        if (lf->codec == LUNA_CODEC_JPEG)
+            decode(lf->data, lf->tables_len, p, f->length, fr[i].pix, NULL, NULL);
+        else if (unpack(lf->codec, p, f->length, fr[i].pix, w * h))
+        {
+            fprintf(stderr, "framegen: built in frame %d is damaged\n", i);
+            exit(1);
+        }
+    }
+    return lf->nframe;
+}
+
+static int read_pgm(const char *path, struct frame *f)
+{
+    FILE *in = fopen(path, "rb");
+    int v[3], i, c;
+
+    if (!in || fgetc(in) != 'P' || fgetc(in) != '5')
+    {
+        if (in) fclose(in);
+        return -1;
+    }
+    for (i = 0; i < 3; i++)
+    {
+        while ((c = fgetc(in)) == '#' || c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            if (c == '#')
+                while ((c = fgetc(in)) != '\n' && c != EOF)
+                    ;
+        ungetc(c, in);
+        if (fscanf(in, "%d", &v[i]) != 1) break;
+    }
+    if (i < 3 || v[0] <= 0 || v[1] <= 0 || v[2] != 255)
+    {
+        fclose(in);
+        return -1;
+    }
+    fgetc(in);
+    f->w = v[0];
+    f->h = v[1];
+    f->pix = xmalloc((size_t) f->w * f->h);
+    i = fread(f->pix, (size_t) f->w * f->h, 1, in) == 1 ? 0 : -1;
+    fclose(in);
+    return i;
+}
+
+static int list_frames(const char *list, struct frame *fr)
+{
+    char line[1024], path[1200], file[1024];
+    const char *slash = strrchr(list, '/');
+    int dirlen = slash ? (int) (slash - list + 1) : 0, n = 0;
+    FILE *in = fopen(list, "r");
+    float phase;
+
+    if (!in)
+    {
+        perror(list);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), in))
+    {
+        if (line[0] == '#' || sscanf(line, "%f %1023s", &phase, file) != 2)
+            continue;
+        if (file[0] == '/') snprintf(path, sizeof(path), "%s", file);
+        else snprintf(path, sizeof(path), "%.*s%s", dirlen, list, file);
+        if (n == MAXFRAME || read_pgm(path, &fr[n]) != 0)
+        {
+            fprintf(stderr, "framegen: %s: not an 8 bit PGM, or too many frames\n", path);
+            exit(1);
+        }
+        fr[n].phase = phase;
+        n++;
+    }
+    fclose(in);
+    return n;
+}
+
+static void extract(const char *dir, const struct frame *fr, int n)
+{
+    char path[1024];
+    FILE *list, *out;
+    int i;
+
+    snprintf(path, sizeof(path), "%s/frames.txt", dir);
+    list = fopen(path, "w");
+    if (!list)
+    {
+        perror(path);
+        exit(1);
+    }
+    fprintf(list, "# phase frame, as read by framegen -i\n");
+    for (i = 0; i < n; i++)
+    {
+        snprintf(path, sizeof(path), "%s/frame%02d.pgm", dir, i);
+        out = fopen(path, "wb");
+        if (!out)
+        {
+            perror(path);
+            exit(1);
+        }
+        fprintf(out, "P5\n%d %d\n255\n", fr[i].w, fr[i].h);
+        fwrite(fr[i].pix, (size_t) fr[i].w * fr[i].h, 1, out);
+        fclose(out);
+        fprintf(list, "%.9g frame%02d.pgm\n", fr[i].phase, i);
+    }
+    fclose(list);
+}
+
+/* -------------------------------------------------------------------- */
+/*  Frame selection and scaling                                         */
+
+static int cmp_phase(const void *a, const void *b)
+{
+    float x = ((const struct frame *) a)->phase, y = ((const struct frame *) b)->phase;
+    return x < y ? -1 : x > y;
+}
+
+/*  Source frame nearest in phase to each of n evenly spaced phases,
+    leaving out repeats; returns how many were picked.  A single frame
+    is the full moon, which is all the hybrid renderer needs.  */
+static int pick(const struct frame *src, int nsrc, int n, int *which)
+{
+    int k, i, best, m = 0;
+    double d, dbest;
+
+    for (k = 0; k < n; k++)
+    {
+        best = 0;
+        dbest = 2;
+        for (i = 0; i < nsrc; i++)
+        {
+            d = fabs(src[i].phase - (n == 1 ? 0.5 : (double) k / n));
+            if (d > 0.5) d = 1 - d;
+            if (d < dbest)
+            {
+                dbest = d;
+                best = i;
+            }
+        }
+        if (m == 0 || which[m - 1] != best) which[m++] = best;
+    }
+    if (m > 1 && which[m - 1] == which[0]) m--;
+    return m;
+}
+
+/*  Area weighted resampling, which is exact at equal sizes.  */
+static void scale(const struct frame *src, uint8_t *dst, int size)
+{
+    double *row = xmalloc((size_t) size * src->h * sizeof(double));
+    double sx = (double) src->w / size, sy = (double) src->h / size;
+    double a, b, w, acc;
+    int x, y, i;
+
+    for (y = 0; y < src->h; y++)
+        for (x = 0; x < size; x++)
+        {
+            a = x * sx;
+            b = a + sx;
+            acc = 0;
+            for (i = (int) a; i < b && i < src->w; i++)
+            {
+                w = (i + 1 < b ? i + 1 : b) - (i > a ? i : a);
+                acc += w * src->pix[y * src->w + i];
+            }
+            row[y * size + x] = acc / sx;
+        }
+    for (x = 0; x < size; x++)
+        for (y = 0; y < size; y++)
+        {
+            a = y * sy;
+            b = a + sy;
+            acc = 0;
+            for (i = (int) a; i < b && i < src->h; i++)
+            {
+                w = (i + 1 < b ? i + 1 : b) - (i > a ? i : a);
+                acc += w * row[i * size + x];
+            }
+            acc = floor(acc / sy + 0.5);
+            dst[y * size + x] = (uint8_t) (acc < 0 ? 0 : acc > 255 ? 255 : acc);
+        }
+    free(row);
+}
+
+/* -------------------------------------------------------------------- */
+/*  Encoding                                                            */
+
+/*  One frame in a coding other than JPEG into out, which holds twice
+    its pixels; returns the bytes written.  */
+static size_t pack(int codec, const uint8_t *pix, int npix, uint8_t *out)
+{
+    uint8_t *o = out, last = 0;
+    int i = 0, run, d;
+
+    while (i < npix)
+    {
+        if (codec == LUNA_CODEC_RAW)
+        {
+            *o++ = pix[i++];
+            continue;
+        }
+        if (codec == LUNA_CODEC_RLE)
+        {
+            last = (uint8_t) ((pix[i] * 15 + 127) / 255);
+            for (run = 1; run < 16 && i + run < npix &&
+                          (pix[i + run] * 15 + 127) / 255 == last; run++)
+                ;
+            *o++ = (uint8_t) (last << 4 | (run - 1));
+            i += run;
+            continue;
+        }
+        for (run = 0; run < 64 && i + run < npix && pix[i + run] == last; run++)
+            ;
+        if (run)
+        {
+            *o++ = (uint8_t) (run - 1);
+            i += run;
+            continue;
+        }
+        d = (int8_t) (uint8_t) (pix[i] - last);
+        if (d >= -32 && d < 32)
+            *o++ = (uint8_t) (0x60 + d);
+        else
+        {
+            *o++ = 0x80;
+            *o++ = pix[i];
+        }
+        last = pix[i++];
+    }
+    return (size_t) (o - out);
+}
+
+/*  Frames as key frames every keys frames and in between the 8x8 blocks
+    that differ by more than tol from the frame before as it decodes.  */
+static void encode_delta(uint8_t **pix, int n, int size, int keys, int tol,
+        struct frameset *fs)
+{
+    int per = size * size, bw = size / 8, nblock = bw * bw, i, b, y, x, nb, d;
+    uint8_t *rec = xmalloc(per), *blocks = xmalloc(per), *o;
+
+    fs->tables = xmalloc(1);
+    fs->data = xmalloc((size_t) n * (2 * per + nblock / 8 + 2));
+    fs->ntables = fs->ndata = 0;
+    for (i = 0; i < n; i++)
+    {
+        fs->offset[i] = fs->ndata;
+        o = fs->data + fs->ndata;
+        if (i % keys == 0)
+        {
+            *o++ = 0;
+            o += pack(LUNA_CODEC_QOI, pix[i], per, o);
+            memcpy(rec, pix[i], per);
+        }
+        else
+        {
+            *o++ = 1;
+            memset(o, 0, (nblock + 7) / 8);
+            for (b = nb = 0; b < nblock; b++)
+            {
+                const uint8_t *p = pix[i] + (b / bw) * 8 * size + (b % bw) * 8;
+                uint8_t *r = rec + (p - pix[i]);
+
+                for (y = d = 0; y < 8 && d <= tol; y++)
+                    for (x = 0; x < 8; x++)
+                        if (abs(p[y * size + x] - r[y * size + x]) > d)
+                            d = abs(p[y * size + x] - r[y * size + x]);
+                if (d <= tol) continue;
+                o[b >> 3] |= (uint8_t) (1 << (b & 7));
+                for (y = 0; y < 8; y++)
+                {
+                    memcpy(blocks + nb * 64 + y * 8, p + y * size, 8);
+                    memcpy(r + y * size, p + y * size, 8);
+                }
+                nb++;
+            }
+            o += (nblock + 7) / 8;
+            o += pack(LUNA_CODEC_QOI, blocks, nb * 64, o);
+        }
+        fs->ndata = o - fs->data;
+    }
+    fs->offset[n] = fs->ndata;
+    free(rec);
+    free(blocks);
+}
+
+static void encode(uint8_t **pix, int n, int size, int quality, int restart,
+        int mode, int keys, int tol, struct frameset *fs)
+{
+    struct jpeg_enc e;
+    int16_t *coef;
+    long dc[257], ac[257];
+    size_t per = (size_t) size * size;
+    int i;
+
+    fs->codec = mode_codec[mode];
+    if (fs->codec == LUNA_CODEC_DELTA)
+    {
+        encode_delta(pix, n, size, keys, tol, fs);
+        return;
+    }
+    if (fs->codec != LUNA_CODEC_JPEG)
+    {
+        fs->tables = xmalloc(1);
+        fs->data = xmalloc(n * 2 * per);
+        fs->ntables = fs->ndata = 0;
+        for (i = 0; i < n; i++)
+        {
+            fs->offset[i] = fs->ndata;
+            fs->ndata += pack(fs->codec, pix[i], (int) per, fs->data + fs->ndata);
+        }
+        fs->offset[n] = fs->ndata;
+        return;
+    }
+    coef = xmalloc((size_t) n * per * sizeof(int16_t));
+    jpeg_enc_init(&e, size, size, quality, restart);
+    for (i = 0; i < n; i++) jpeg_blocks(&e, pix[i], coef + i * per);
+
+    fs->tables = xmalloc(4096);
+    fs->data = xmalloc(n * (JPEG_BOUND(size, size) + 4096));
+    fs->ntables = fs->ndata = 0;
+    if (mode == MODE_ABBREV)
+    {
+        memset(dc, 0, sizeof(dc));
+        memset(ac, 0, sizeof(ac));
+        for (i = 0; i < n; i++) jpeg_count(&e, coef + i * per, dc, ac);
+        jpeg_huff_fit(&e.dc, dc);
+        jpeg_huff_fit(&e.ac, ac);
+        fs->ntables = jpeg_write_tables(&e, fs->tables);
+    }
+    for (i = 0; i < n; i++)
+    {
+        fs->offset[i] = fs->ndata;
+        if (mode == MODE_BASELINE)
+        {
+            memset(dc, 0, sizeof(dc));
+            memset(ac, 0, sizeof(ac));
+            jpeg_count(&e, coef + i * per, dc, ac);
+            jpeg_huff_fit(&e.dc, dc);
+            jpeg_huff_fit(&e.ac, ac);
+            fs->ndata += jpeg_write_tables(&e, fs->data + fs->ndata);
+        }
+        fs->ndata += jpeg_write_frame(&e, coef + i * per, fs->data + fs->ndata);
+    }
+    fs->offset[n] = fs->ndata;
+    free(coef);
+}
+
+static uint32_t fnv1a(uint32_t h, const uint8_t *p, size_t n)
+{
+    while (n--) h = (h ^ *p++) * 16777619u;
+    return h;
+}
+
+/*  Entries for the n frames of fs, with the tables ahead of them, but
+    for their phase.  */
+static void index_frames(const struct frameset *fs, const uint8_t *data, int n, int size,
+        struct luna_frame *frame)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        frame[i].offset = (uint32_t) (fs->ntables + fs->offset[i]);
+        frame[i].length = (uint32_t) (fs->offset[i + 1] - fs->offset[i]);
+        frame[i].width = frame[i].height = (uint16_t) size;
+        frame[i].checksum = luna_checksum(data + frame[i].offset, frame[i].length);
+    }
+}
+
+/*  measure() for delta coded frames, each decoded from the one before.  */
+static void measure_delta(const struct frameset *fs, uint8_t **pix, int n, int size,
+        double *us, double *err)
+{
+    static struct luna_frame frame[MAXFRAME];
+    struct luna_frames lf = { 0 };
+    uint8_t *prev = xmalloc((size_t) size * size), *out = xmalloc((size_t) size * size);
+    double t0, t = 0, best, d;
+    int i, j, have;
+
+    index_frames(fs, fs->data, n, size, frame);
+    lf.nframe = n;
+    lf.codec = fs->codec;
+    lf.frame = frame;
+    lf.data = fs->data;
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0, best = 1; j < 8; j++)
+        {
+            memcpy(out, prev, (size_t) size * size);
+            have = i - 1;
+            t0 = now();
+            if (luna_frame_seek(&lf, i, out, &have))
+            {
+                fprintf(stderr, "framegen: frame %d does not decode\n", i);
+                exit(1);
+            }
+            t0 = now() - t0;
+            if (t0 < best) best = t0;
+        }
+        t += best;
+        for (j = 0; j < size * size; j++)
+        {
+            d = out[j] - pix[i][j];
+            *err += d * d;
+        }
+        memcpy(prev, out, (size_t) size * size);
+    }
+    *us = t / n * 1e6;
+    free(prev);
+    free(out);
+}
+
+/*  Decode every frame of fs, check it against pix and time it, taking
+    the fastest of several runs of each.  Frames not in JPEG are timed
+    unpacking to 16 bit pixels, as for the display.  */
+static void measure(const struct frameset *fs, uint8_t **pix, int n, int size,
+        double *us, double *psnr)
+{
+    uint8_t *out = xmalloc((size_t) size * size);
+    double t0, t, best, err = 0, d;
+    int i, j, w, h;
+
+    t = 0;
+    for (i = 0; i < n && fs->codec != LUNA_CODEC_DELTA; i++)
+    {
+        const uint8_t *p = fs->data + fs->offset[i];
+        size_t len = fs->offset[i + 1] - fs->offset[i];
+
+        w = h = size;
+        if (fs->codec == LUNA_CODEC_JPEG ?
+            decode(fs->tables, fs->ntables, p, len, out, &w, &h) || w != size || h != size :
+            unpack(fs->codec, p, len, out, size * size) != 0)
+        {
+            fprintf(stderr, "framegen: frame %d does not decode\n", i);
+            exit(1);
+        }
+        for (j = 0; j < size * size; j++)
+        {
+            d = out[j] - pix[i][j];
+            err += d * d;
+        }
+        for (j = 0, best = 1; j < 8; j++)
+        {
+            t0 = now();
+            if (fs->codec == LUNA_CODEC_JPEG)
+                decode(fs->tables, fs->ntables, p, len, out, NULL, NULL);
+            else
+                unpack(fs->codec, p, len, NULL, size * size);
+            t0 = now() - t0;
+            if (t0 < best) best = t0;
+        }
+        t += best;
+    }
+    *us = t / n * 1e6;
+    if (fs->codec == LUNA_CODEC_DELTA) measure_delta(fs, pix, n, size, us, &err);
+    err /= (double) n * size * size;
+    *psnr = err > 0 ? 10 * log10(255.0 * 255.0 / err) : 99;
+    free(out);
+}
+
+/* -------------------------------------------------------------------- */
+/*  Output                                                              */
+
+static double distance(double a, double b)
+{
+    double d = fabs(a - b);
+
+    return d > 0.5 ? 1 - d : d;
+}
+
+/*  Buckets for frames in phase order, nearest frame at each bucket
+    start.  There are enough of them, a power of 2, for at most one
+    boundary between nearest frames, which lie halfway between
+    neighbours, to fall in each, as luna_frame_find() needs.  */
+static int make_buckets(const struct luna_frame *fr, int n, uint16_t *bucket)
+{
+    double mid[MAXFRAME], gap = 1, d, p;
+    int i, k, nbucket = 1;
+
+    for (i = 0; i < n; i++)
+    {
+        d = fr[(i + 1) % n].phase - fr[i].phase;
+        mid[i] = fr[i].phase + (d < 0 ? d + 1 : d) / 2;
+    }
+    for (i = 0; i < n && n > 1; i++)
+    {
+        d = mid[(i + 1) % n] - mid[i];
+        if (d < 0) d += 1;
+        if (d < gap) gap = d;
+    }
+    while (nbucket < n || 1.0 / nbucket > gap)
+        nbucket *= 2;
+    if (nbucket > MAXBUCKET)
+    {
+        fprintf(stderr, "framegen: frames too close in phase for %d buckets\n", MAXBUCKET);
+        exit(1);
+    }
+    for (k = 0; k < nbucket; k++)
+    {
+        p = (double) k / nbucket;
+        for (i = 1, bucket[k] = 0; i < n; i++)
+            if (distance(p, fr[i].phase) < distance(p, fr[bucket[k]].phase))
+                bucket[k] = (uint16_t) i;
+    }
+    return nbucket;
+}
+
+/*  Check luna_frame_find() against a full search on a fine grid.  */
+static void check_find(const struct luna_frames *lf)
+{
+    double p, best;
+    int k, i;
+
+    for (k = 0; k < 1 << 16; k++)
+    {
+        p = (k + 0.5) / (1 << 16);
+        for (i = 0, best = 1; i < lf->nframe; i++)
+            if (distance(p, lf->frame[i].phase) < best) best = distance(p, lf->frame[i].phase);
+        if (distance(p, lf->frame[luna_frame_find(lf, p)].phase) > best)
+        {
+            fprintf(stderr, "framegen: frames not in phase order\n");
+            exit(1);
+        }
+    }
+}
+
+/*  dir/luna_jpeg.bin, the data; dir/lunaindex.c indexing it; and both
+    in a container for external data, dir/luna_frames.dat.  */
+static void write_assets(const char *dir, const char *cmdline,
+        const struct luna_frames *lf, uint32_t data_len)
+{
+    struct luna_frames_file h;
+    size_t nindex = lf->nframe * sizeof(struct luna_frame) +
+                    ((lf->nbucket * sizeof(uint16_t) + 3) & ~(size_t) 3);
+    uint8_t *index;
+    char path[1024];
+    FILE *out;
+    int i;
+
+    check_find(lf);
+    snprintf(path, sizeof(path), "%s/luna_jpeg.bin", dir);
+    out = fopen(path, "wb");
+    if (!out || fwrite(lf->data, 1, data_len, out) != data_len || fclose(out) != 0)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    snprintf(path, sizeof(path), "%s/lunaindex.c", dir);
+    out = fopen(path, "w");
+    if (!out)
+    {
+        perror(path);
+        exit(1);
+    }
+    fprintf(out, "/* Moon frame index, written by tools/framegen%s; do not edit */\n\n"
+                 "#include \"lunaframes.h\"\n\n", cmdline);
+    fprintf(out, "static const struct luna_frame frame[%d] = {\n"
+                 "  /* offset, length, phase, width, height, checksum */\n", lf->nframe);
+    for (i = 0; i < lf->nframe; i++)
+    {
+        const struct luna_frame *f = &lf->frame[i];
+
+        fprintf(out, "  { %6u, %5u, %.9gf, %u, %u, 0x%08x }%s\n", (unsigned) f->offset,
+                (unsigned) f->length, f->phase, f->width, f->height,
+                (unsigned) f->checksum, i + 1 < lf->nframe ? "," : "");
+    }
+    fprintf(out, "};\n\nstatic const uint16_t bucket[%d] = {", lf->nbucket);
+    for (i = 0; i < lf->nbucket; i++)
+        fprintf(out, "%s%d%s", i % 16 ? " " : "\n  ", lf->bucket[i],
+                i + 1 < lf->nbucket ? "," : "\n");
+    fprintf(out, "};\n\nconst struct luna_frames luna_frames = "
+                 "{ %d, %d, %u, %s, frame, bucket, luna_jpeg };\n",
+            lf->nframe, lf->nbucket, (unsigned) lf->tables_len, codec_name[lf->codec]);
+    if (fclose(out) != 0)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    snprintf(path, sizeof(path), "%s/luna_frames.dat", dir);
+    index = calloc(1, nindex);
+    memcpy(index, lf->frame, lf->nframe * sizeof(struct luna_frame));
+    memcpy(index + lf->nframe * sizeof(struct luna_frame), lf->bucket,
+           lf->nbucket * sizeof(uint16_t));
+    memset(&h, 0, sizeof(h));
+    h.magic = LUNA_FRAMES_MAGIC;
+    h.version = LUNA_FRAMES_VERSION;
+    h.header_size = sizeof(h);
+    h.nframe = (uint16_t) lf->nframe;
+    h.nbucket = (uint16_t) lf->nbucket;
+    h.codec = (uint16_t) lf->codec;
+    h.tables_len = lf->tables_len;
+    h.data_len = data_len;
+    h.index_checksum = luna_checksum(index, nindex);
+    out = fopen(path, "wb");
+    if (!out || fwrite(&h, sizeof(h), 1, out) != 1 ||
+        fwrite(index, 1, nindex, out) != nindex ||
+        fwrite(lf->data, 1, data_len, out) != data_len || fclose(out) != 0)
+    {
+        perror(path);
+        exit(1);
+    }
+    free(index);
+}
+
+/*  Index an encoded set of n frames and write it out.  */
+static void write_set(const char *dir, const char *cmdline, const struct frameset *fs,
+        const float *phase, int n, int size)
+{
+    static struct luna_frame frame[MAXFRAME];
+    static uint16_t bucket[MAXBUCKET];
+    struct luna_frames lf;
+    uint8_t *data = xmalloc(fs->ntables + fs->ndata);
+    int i;
+
+    memcpy(data, fs->tables, fs->ntables);
+    memcpy(data + fs->ntables, fs->data, fs->ndata);
+    index_frames(fs, data, n, size, frame);
+    for (i = 0; i < n; i++) frame[i].phase = phase[i];
+    lf.nframe = n;
+    lf.nbucket = make_buckets(frame, n, bucket);
+    lf.tables_len = (uint32_t) fs->ntables;
+    lf.codec = fs->codec;
+    lf.frame = frame;
+    lf.bucket = bucket;
+    lf.data = data;
+    write_assets(dir, cmdline, &lf, (uint32_t) (fs->ntables + fs->ndata));
+    free(data);
+}
+
+static int parse_list(const char *s, int *v, const char *const *names, int nnames)
+{
+    char buf[256], *tok;
+    int n = 0, i;
+
+    snprintf(buf, sizeof(buf), "%s", s);
+    for (tok = strtok(buf, ","); tok && n < MAXCONF; tok = strtok(NULL, ","))
+    {
+        if (names)
+        {
+            for (i = 0; i < nnames && strcmp(tok, names[i]) != 0; i++)
+                ;
+            if (i == nnames) return -1;
+            v[n++] = i;
+        } else
+            v[n++] = atoi(tok);
+    }
+    return n;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct frame src[MAXFRAME];
+    struct frameset fs;
+    uint8_t *pix[MAXFRAME];
+    float phase[MAXFRAME];
+    int which[MAXFRAME], q[MAXCONF] = { 50 }, r[MAXCONF] = { 0 }, m[MAXCONF] = { 0 };
+    int nq = 1, nr = 1, nm = 1, nsrc, n, size = 240, want = 0, keys = 8, tol = 0;
+    int i, iq, ir, im;
+    const char *list = NULL, *dir = NULL, *outdir = NULL;
+    char cmdline[512] = "";
+    double us, psnr;
+
+    for (i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-i") == 0) list = argv[i + 1];
+        else if (strcmp(argv[i], "-x") == 0) dir = argv[i + 1];
+        else if (strcmp(argv[i], "-n") == 0) want = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-r") == 0) size = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-q") == 0) nq = parse_list(argv[i + 1], q, NULL, 0);
+        else if (strcmp(argv[i], "-R") == 0) nr = parse_list(argv[i + 1], r, NULL, 0);
+        else if (strcmp(argv[i], "-m") == 0) nm = parse_list(argv[i + 1], m, mode_name, NMODE);
+        else if (strcmp(argv[i], "-K") == 0) keys = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0) tol = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-o") == 0) outdir = argv[i + 1];
+        else break;
+        if (strcmp(argv[i], "-o") != 0 && strcmp(argv[i], "-x") != 0)
+            snprintf(cmdline + strlen(cmdline), sizeof(cmdline) - strlen(cmdline),
+                     " %s %s", argv[i], argv[i + 1]);
+    }
+    if (argc == 3 && strcmp(argv[1], "-e") == 0)
+    {
+        write_assets(argv[2], "", &luna_frames, (uint32_t) (luna_jpeg_end - luna_jpeg));
+        return 0;
+    }
+    if (i < argc || nq < 1 || nr < 1 || nm < 1 || size < 8 || size % 8 ||
+        want < 0 || want > MAXFRAME || keys < 1 || tol < 0 ||
+        (outdir && nq * nr * nm != 1))
+    {
+        fprintf(stderr, "usage: framegen [-i list | -x dir] [-n frames] [-r size] "
+                        "[-q quality,...]\n                [-R restart,...] "
+                        "[-m baseline|abbrev|raw|rle|qoi|delta,...]\n"
+                        "                [-K keys] [-t tolerance] [-o dir]\n"
+                        "       framegen -e dir\n");
+        return 2;
+    }
+
+    nsrc = list ? list_frames(list, src) : builtin_frames(src);
+    qsort(src, nsrc, sizeof(src[0]), cmp_phase);
+    if (dir)
+    {
+        extract(dir, src, nsrc);
+        return 0;
+    }
+    if (want)
+        n = pick(src, nsrc, want, which);
+    else
+        for (n = 0; n < nsrc; n++) which[n] = n;
+    for (i = 0; i < n; i++)
+    {
+        pix[i] = xmalloc((size_t) size * size);
+        scale(&src[which[i]], pix[i], size);
+        phase[i] = src[which[i]].phase;
+    }
+    printf("framegen: %d of %d source frames at %dx%d\n", n, nsrc, size, size);
+    printf("  mode      quality restart      bytes  per frame  decode us    PSNR  checksum\n");
+
+    for (im = 0; im < nm; im++)
+        for (iq = 0; iq < nq; iq++)
+            for (ir = 0; ir < nr; ir++)
+            {
+                if (mode_codec[m[im]] != LUNA_CODEC_JPEG && iq + ir > 0) continue;
+                encode(pix, n, size, q[iq], r[ir], m[im], keys, tol, &fs);
+                measure(&fs, pix, n, size, &us, &psnr);
+                if (fs.codec == LUNA_CODEC_JPEG)
+                    printf("  %-9s %7d %7d", mode_name[m[im]], q[iq], r[ir]);
+                else
+                    printf("  %-9s %7s %7s", mode_name[m[im]], "-", "-");
+                printf(" %10zu %10.0f %10.0f %7.2f  %08x\n", fs.ntables + fs.ndata,
+                       (double) (fs.ntables + fs.ndata) / n, us, psnr,
+                       fnv1a(fnv1a(2166136261u, fs.tables, fs.ntables), fs.data, fs.ndata));
+                if (outdir) write_set(outdir, cmdline, &fs, phase, n, size);
+                free(fs.tables);
+                free(fs.data);
+            }
+    return 0;
+}
@@ -0,0 +1,394 @@
+/*
+ * jpegenc - baseline greyscale JPEG encoder for the frame generator
+ *
+ * Just enough of ITU T.81 for the moon frames: one 8 bit component,
+ * sequential Huffman coding, the Annex K luminance quantiser scaled by
+ * the usual quality factor, optional restart intervals and Huffman
+ * tables fitted to the data after Annex K.2.  Tables and frames are
+ * written separately, so a set of frames can share one set of tables
+ * ("abbreviated" streams), which picojpeg reads if the tables are fed
+ * to it first.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "moonconst.h"
+#include "jpegenc.h"
+
+static const uint8_t zigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+/*  Annex K.1, natural order  */
+static const uint8_t luminance[64] = {
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99
+};
+
+/*  Annex K.3, luminance DC and AC  */
+static const uint8_t dc_bits[17] = { 0, 0, 1, 5, 1, 1, 1, 1, 1, 1 };
+static const uint8_t ac_bits[17] = { 0, 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const uint8_t ac_val[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
+    0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+    0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+    0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75,
+    0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+    0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+    0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9,
+    0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4,
+    0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa
+};
+
+/*  Codes from bits[] and val[] after Annex C.  */
+static void huff_codes(struct jpeg_huff *hf)
+{
+    unsigned code = 0;
+    int l, i, k = 0;
+
+    memset(hf->size, 0, sizeof(hf->size));
+    for (l = 1; l <= 16; l++)
+    {
+        for (i = 0; i < hf->bits[l]; i++, k++)
+        {
+            hf->code[hf->val[k]] = (uint16_t) code++;
+            hf->size[hf->val[k]] = (uint8_t) l;
+        }
+        code <<= 1;
+    }
+}
+
+/*  Standard quantiser scaled to quality (1 to 100) and the Annex K
+    Huffman tables; see jpeg_huff_fit() for better ones.  */
+void jpeg_enc_init(struct jpeg_enc *e, int w, int h, int quality, int restart)
+{
+    int i, s, q;
+
+    e->w = w;
+    e->h = h;
+    e->restart = restart;
+    if (quality < 1) quality = 1;
+    if (quality > 100) quality = 100;
+    s = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+    for (i = 0; i < 64; i++)
+    {
+        q = (luminance[zigzag[i]] * s + 50) / 100;
+        e->qt[i] = (uint8_t) (q < 1 ? 1 : q > 255 ? 255 : q);
+    }
+
+    memcpy(e->dc.bits, dc_bits, sizeof(dc_bits));
+    for (i = 0; i < 12; i++) e->dc.val[i] = (uint8_t) i;
+    huff_codes(&e->dc);
+    memcpy(e->ac.bits, ac_bits, sizeof(ac_bits));
+    memcpy(e->ac.val, ac_val, sizeof(ac_val));
+    huff_codes(&e->ac);
+}
+
+/*  Forward DCT and quantisation of every 8x8 block of img, blocks in
+    raster order, coefficients in zigzag order.  */
+void jpeg_blocks(const struct jpeg_enc *e, const uint8_t *img, int16_t *coef)
+{
+    static double c[8][8];
+    double tmp[64], f;
+    int bx, by, u, v, x, y, i;
+
+    if (c[0][0] == 0)
+        for (u = 0; u < 8; u++)
+            for (x = 0; x < 8; x++)
+                c[u][x] = (u ? 0.5 : sqrt(0.125)) * cos((2 * x + 1) * u * PI / 16);
+
+    for (by = 0; by < e->h; by += 8)
+        for (bx = 0; bx < e->w; bx += 8, coef += 64)
+        {
+            /* rows, then columns */
+            for (y = 0; y < 8; y++)
+                for (u = 0; u < 8; u++)
+                {
+                    f = 0;
+                    for (x = 0; x < 8; x++)
+                        f += c[u][x] * (img[(by + y) * e->w + bx + x] - 128);
+                    tmp[y * 8 + u] = f;
+                }
+            for (i = 0; i < 64; i++)
+            {
+                u = zigzag[i] & 7;
+                v = zigzag[i] >> 3;
+                f = 0;
+                for (y = 0; y < 8; y++) f += c[v][y] * tmp[y * 8 + u];
+                f /= e->qt[i];
+                f = f < 0 ? -floor(0.5 - f) : floor(f + 0.5);
+                if (f > 1023) f = 1023;
+                if (f < -1023) f = -1023;
+                coef[i] = (int16_t) f;
+            }
+        }
+}
+
+static int category(int v)
+{
+    int n = 0;
+
+    if (v < 0) v = -v;
+    while (v)
+    {
+        n++;
+        v >>= 1;
+    }
+    return n;
+}
+
+/*  Add the symbols jpeg_write_frame() would code for coef to the
+    frequencies dc[] and ac[].  */
+void jpeg_count(const struct jpeg_enc *e, const int16_t *coef, long dc[257],
+        long ac[257])
+{
+    int nblock = (e->w / 8) * (e->h / 8), b, i, run, pred = 0;
+
+    for (b = 0; b < nblock; b++, coef += 64)
+    {
+        if (e->restart && b % e->restart == 0) pred = 0;
+        dc[category(coef[0] - pred)]++;
+        pred = coef[0];
+        for (i = 1, run = 0; i < 64; i++)
+        {
+            if (coef[i] == 0)
+            {
+                run++;
+                continue;
+            }
+            for (; run > 15; run -= 16) ac[0xf0]++;
+            ac[(run << 4) | category(coef[i])]++;
+            run = 0;
+        }
+        if (run) ac[0x00]++;
+    }
+}
+
+/*  Optimal code lengths for freq[0..255], limited to 16 bits, after
+    Annex K.2; freq[256] is ignored and stands for the reserved all ones
+    code.  */
+void jpeg_huff_fit(struct jpeg_huff *hf, const long freq[257])
+{
+    long f[257];
+    int codesize[257], others[257], bits[33];
+    int c1, c2, i, j, k;
+    long v;
+
+    memcpy(f, freq, sizeof(f));
+    f[256] = 1;
+    for (i = 0; i < 257; i++)
+    {
+        codesize[i] = 0;
+        others[i] = -1;
+    }
+    for (;;)
+    {
+        c1 = c2 = -1;
+        for (i = 0, v = 0; i < 257; i++)
+            if (f[i] && (c1 < 0 || f[i] <= v))
+            {
+                v = f[i];
+                c1 = i;
+            }
+        for (i = 0, v = 0; i < 257; i++)
+            if (f[i] && i != c1 && (c2 < 0 || f[i] <= v))
+            {
+                v = f[i];
+                c2 = i;
+            }
+        if (c2 < 0) break;
+
+        f[c1] += f[c2];
+        f[c2] = 0;
+        codesize[c1]++;
+        while (others[c1] >= 0)
+        {
+            c1 = others[c1];
+            codesize[c1]++;
+        }
+        others[c1] = c2;
+        codesize[c2]++;
+        while (others[c2] >= 0)
+        {
+            c2 = others[c2];
+            codesize[c2]++;
+        }
+    }
+
+    memset(bits, 0, sizeof(bits));
+    for (i = 0; i < 257; i++)
+        if (codesize[i]) bits[codesize[i]]++;
+    for (i = 32; i > 16; i--)
+        while (bits[i] > 0)
+        {
+            for (j = i - 2; bits[j] == 0; j--)
+                ;
+            bits[i] -= 2;
+            bits[i - 1]++;
+            bits[j + 1] += 2;
+            bits[j]--;
+        }
+    for (i = 16; bits[i] == 0; i--)
+        ;
+    bits[i]--;                      /* the reserved code */
+
+    memset(hf->bits, 0, sizeof(hf->bits));
+    for (i = 1; i <= 16; i++) hf->bits[i] = (uint8_t) bits[i];
+    for (i = 1, k = 0; i <= 32; i++)
+        for (j = 0; j < 256; j++)
+            if (codesize[j] == i) hf->val[k++] = (uint8_t) j;
+    huff_codes(hf);
+}
+
+static uint8_t *put16(uint8_t *p, int v)
+{
+    *p++ = (uint8_t) (v >> 8);
+    *p++ = (uint8_t) v;
+    return p;
+}
+
+static uint8_t *put_huff(uint8_t *p, const struct jpeg_huff *hf, int class)
+{
+    int i, n = 0;
+
+    *p++ = (uint8_t) (class << 4);
+    for (i = 1; i <= 16; i++) n += *p++ = hf->bits[i];
+    memcpy(p, hf->val, n);
+    return p + n;
+}
+
+/*  SOI, DQT and DHT: a full JPEG is these followed by
+    jpeg_write_frame().  */
+size_t jpeg_write_tables(const struct jpeg_enc *e, uint8_t *out)
+{
+    uint8_t *p = out, *len;
+
+    *p++ = 0xff; *p++ = 0xd8;
+    *p++ = 0xff; *p++ = 0xdb;
+    p = put16(p, 67);
+    *p++ = 0;
+    memcpy(p, e->qt, 64);
+    p += 64;
+
+    *p++ = 0xff; *p++ = 0xc4;
+    len = p;
+    p = put_huff(p + 2, &e->dc, 0);
+    p = put_huff(p, &e->ac, 1);
+    put16(len, (int) (p - len));
+    return (size_t) (p - out);
+}
+
+struct bitwriter {
+    uint8_t *p;
+    uint32_t acc;
+    int n;
+};
+
+static inline void put_bits(struct bitwriter *b, unsigned code, int size)
+{
+    b->acc = (b->acc << size) | code;
+    b->n += size;
+    while (b->n >= 8)
+    {
+        uint8_t c = (uint8_t) (b->acc >> (b->n - 8));
+
+        *b->p++ = c;
+        if (c == 0xff) *b->p++ = 0;
+        b->n -= 8;
+    }
+    b->acc &= (1u << b->n) - 1;
+}
+
+/*  Pad to a byte with ones.  */
+static void flush_bits(struct bitwriter *b)
+{
+    if (b->n) put_bits(b, (1u << (8 - b->n)) - 1, 8 - b->n);
+}
+
+static inline void put_value(struct bitwriter *b, const struct jpeg_huff *hf,
+        int symbol, int v, int size)
+{
+    put_bits(b, hf->code[symbol], hf->size[symbol]);
+    if (size) put_bits(b, (unsigned) (v < 0 ? v - 1 : v) & ((1u << size) - 1), size);
+}
+
+/*  SOF0, DRI if restarting, SOS, the entropy coded blocks and EOI.  */
+size_t jpeg_write_frame(const struct jpeg_enc *e, const int16_t *coef,
+        uint8_t *out)
+{
+    int nblock = (e->w / 8) * (e->h / 8), b, i, run, pred = 0, d;
+    struct bitwriter bw;
+    uint8_t *p = out;
+
+    *p++ = 0xff; *p++ = 0xc0;
+    p = put16(p, 11);
+    *p++ = 8;
+    p = put16(p, e->h);
+    p = put16(p, e->w);
+    *p++ = 1;
+    *p++ = 1; *p++ = 0x11; *p++ = 0;
+    if (e->restart)
+    {
+        *p++ = 0xff; *p++ = 0xdd;
+        p = put16(p, 4);
+        p = put16(p, e->restart);
+    }
+    *p++ = 0xff; *p++ = 0xda;
+    p = put16(p, 8);
+    *p++ = 1;
+    *p++ = 1; *p++ = 0;
+    *p++ = 0; *p++ = 63; *p++ = 0;
+
+    bw.p = p;
+    bw.acc = 0;
+    bw.n = 0;
+    for (b = 0; b < nblock; b++, coef += 64)
+    {
+        if (e->restart && b && b % e->restart == 0)
+        {
+            flush_bits(&bw);
+            *bw.p++ = 0xff;
+            *bw.p++ = (uint8_t) (0xd0 + (b / e->restart - 1) % 8);
+            pred = 0;
+        }
+        d = coef[0] - pred;
+        pred = coef[0];
+        put_value(&bw, &e->dc, category(d), d, category(d));
+        for (i = 1, run = 0; i < 64; i++)
+        {
+            if (coef[i] == 0)
+            {
+                run++;
+                continue;
+            }
+            for (; run > 15; run -= 16) put_bits(&bw, e->ac.code[0xf0], e->ac.size[0xf0]);
+            d = category(coef[i]);
+            put_value(&bw, &e->ac, (run << 4) | d, coef[i], d);
+            run = 0;
+        }
+        if (run) put_bits(&bw, e->ac.code[0x00], e->ac.size[0x00]);
+    }
+    flush_bits(&bw);
+    p = bw.p;
+    *p++ = 0xff; *p++ = 0xd9;
+    return (size_t) (p - out);
+}
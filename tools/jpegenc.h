@@ -0,0 +1,37 @@
+/*
+ * jpegenc - baseline greyscale JPEG encoder for the frame generator
+ */
+
+#ifndef JPEGENC_H
+#define JPEGENC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct jpeg_huff {
+    uint8_t bits[17];               /* codes of each length, bits[1..16] */
+    uint8_t val[256];               /* symbols in code order */
+    uint16_t code[256];             /* code and length of each symbol */
+    uint8_t size[256];
+};
+
+struct jpeg_enc {
+    int w, h;                       /* multiples of 8 */
+    int restart;                    /* blocks between restart markers, 0 none */
+    uint8_t qt[64];                 /* quantiser, zigzag order */
+    struct jpeg_huff dc, ac;
+};
+
+/*  Worst case output of jpeg_write_frame() for a w by h image.  */
+#define JPEG_BOUND(w, h) ((size_t) (w) * (h) * 4 + 1024)
+
+void jpeg_enc_init(struct jpeg_enc *e, int w, int h, int quality, int restart);
+void jpeg_blocks(const struct jpeg_enc *e, const uint8_t *img, int16_t *coef);
+void jpeg_count(const struct jpeg_enc *e, const int16_t *coef, long dc[257],
+        long ac[257]);
+void jpeg_huff_fit(struct jpeg_huff *hf, const long freq[257]);
+size_t jpeg_write_tables(const struct jpeg_enc *e, uint8_t *out);
+size_t jpeg_write_frame(const struct jpeg_enc *e, const int16_t *coef,
+        uint8_t *out);
+
+#endif
@@ -0,0 +1,815 @@
+/*
+ * lunabench - host benchmarks for the Luna astronomy code
+ *
+ * usage: lunabench [benchmark...]
+ *
+ * Runs the named benchmarks, or all of them without arguments.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "moontool.h"
+#include "moonconst.h"
+#include "moonbatch.h"
+#include "moonfit.h"
+#include "moonstep.h"
+#include "moonevent.h"
+#include "mooneclipse.h"
+#include "moonrise.h"
+#include "moonsky.h"
+#include "mooncal.h"
+#include "meeusphase.h"
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* keeps results alive so the timed loops are not optimised away */
+static volatile double sink;
+
+/*  Small deterministic generator, so runs are comparable.  */
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static double uniform(double lo, double hi)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return lo + (hi - lo) * ((rng_state >> 11) * (1.0 / 9007199254740992.0));
+}
+
+/* -------------------------------------------------------------------- */
+/*  time: integer civil conversion against the mktime/gmtime versions   */
+
+static double legacy_jtime(struct tm *t)
+{
+    return ( mktime(t) / 86400.0 ) + 2440587.5;
+}
+
+static struct tm legacy_timej(double jtime)
+{
+    time_t t;
+    t = (time_t) ((jtime - 2440587.5) * 86400.0);
+    return *gmtime(&t);
+}
+
+static void bench_time(void)
+{
+    enum { N = 1000000 };
+    static double jd[N];
+    static time_t secs[N];
+    static struct tm tm[N];
+    double t0, t1, t2, t3, t4, acc;
+    long i, mismatch;
+    struct tm a, b;
+
+    setenv("TZ", "UTC", 1);
+    tzset();
+
+    /* whole seconds plus a quarter, inside the 32-bit time_t range */
+    for (i = 0; i < N; i++)
+    {
+        secs[i] = (time_t) floor(uniform(-2.1e9, 2.1e9));
+        jd[i] = (secs[i] + 0.25) / 86400.0 + 2440587.5;
+    }
+
+    mismatch = 0;
+    for (i = 0; i < N; i++)
+    {
+        /* legacy_timej() truncates towards zero, one second off before 1970 */
+        a = *gmtime(&secs[i]);
+        b = timej(jd[i]);
+        if (a.tm_year != b.tm_year || a.tm_mon != b.tm_mon ||
+            a.tm_mday != b.tm_mday || a.tm_hour != b.tm_hour ||
+            a.tm_min != b.tm_min || a.tm_sec != b.tm_sec ||
+            a.tm_wday != b.tm_wday || a.tm_yday != b.tm_yday)
+            mismatch++;
+        tm[i] = b;
+    }
+    printf("time: %ld/%d calendar mismatches against gmtime()\n", mismatch, N);
+
+    acc = 0;
+    t0 = now();
+    for (i = 0; i < N; i++) { a = legacy_timej(jd[i]); acc += a.tm_sec; }
+    t1 = now();
+    for (i = 0; i < N; i++) { a = timej(jd[i]); acc += a.tm_sec; }
+    t2 = now();
+    for (i = 0; i < N; i++) { a = tm[i]; acc += legacy_jtime(&a); }
+    t3 = now();
+    for (i = 0; i < N; i++) { a = tm[i]; acc += jtime(&a); }
+    t4 = now();
+    sink = acc;
+
+    printf("time: timej  gmtime %7.1f ns  integer %7.1f ns\n",
+           (t1 - t0) / N * 1e9, (t2 - t1) / N * 1e9);
+    printf("time: jtime  mktime %7.1f ns  integer %7.1f ns\n",
+           (t3 - t2) / N * 1e9, (t4 - t3) / N * 1e9);
+
+    /* round trip over +-10000 years, where time_t based code cannot go */
+    mismatch = 0;
+    for (i = 0; i < N; i++)
+    {
+        double j = floor(uniform(-3.6e6, 3.6e6) * 86400.0) / 86400.0 + 2440587.5;
+        a = timej(j);
+        if (fabs(jtime(&a) - j) > 0.5 / 86400.0) mismatch++;
+    }
+    printf("time: %ld/%d round trip failures over +-10000 years\n", mismatch, N);
+}
+
+/* -------------------------------------------------------------------- */
+/*  cache: the app's next new and full moon searches, redraw by redraw  */
+
+/*  n redraws step days apart from 2024, each searching for the next full
+    and new moon as the main screen does, with phase_search_cached() and
+    then with phase_search_forward().  */
+static void cache_walk(const char *label, double step, long n)
+{
+    const struct phase_search_stats *st = phase_search_stats();
+    unsigned long calls = st->calls, hits = st->hits, evals = st->evaluations, plain;
+    double jd0 = days_from_civil(2024, 1, 1) + 2440587.5, jd, t0, t1, t2, acc = 0;
+    long i;
+
+    t0 = now();
+    for (i = 0; i < n; i++)
+    {
+        jd = jd0 + i * step;
+        acc += phase_search_cached(jd, 0.5) + phase_search_cached(jd, 1.0);
+    }
+    t1 = now();
+    calls = st->calls - calls;
+    hits = st->hits - hits;
+    evals = st->evaluations - evals;
+    plain = st->evaluations;
+    for (i = 0; i < n; i++)
+    {
+        jd = jd0 + i * step;
+        acc += phase_search_forward(jd, 0.5) + phase_search_forward(jd, 1.0);
+    }
+    t2 = now();
+    plain = st->evaluations - plain;
+    sink = acc;
+    printf("cache: %ld redraws %s apart: %lu of %lu calls hit (%.1f%%), "
+           "%.2f moon_phase() calls and %.2f us a redraw, uncached %.1f and %.2f us\n",
+           n, label, hits, calls, 100.0 * hits / calls, (double) evals / n,
+           (t1 - t0) / n * 1e6, (double) plain / n, (t2 - t1) / n * 1e6);
+}
+
+static void bench_cache(void)
+{
+    cache_walk("an hour", 1 / 24.0, 24 * 366);
+    cache_walk("a day", 1, 10 * 366);
+}
+
+/* -------------------------------------------------------------------- */
+/*  kernel: moon_phase() variants, speed and deviation from double     */
+
+#define JD1900  2415020.5
+#define JD2100  2488069.5
+
+/*  Largest difference in seconds between the new and full moons that
+    kernel finds and the ones the reference kernel finds, 1900-2100.  */
+static double max_event_error(moon_phase_fn kernel, moon_phase_fn ref)
+{
+    double jd, tref, t, err, maxerr;
+    int target;
+
+    maxerr = 0;
+    for (target = 0; target < 2; target++)
+    {
+        jd = JD1900;
+        while ((tref = phase_search_with(ref, jd, target ? 0.5 : 1.0)) > 0 &&
+               tref < JD2100)
+        {
+            t = phase_search_with(kernel, tref - 5, target ? 0.5 : 1.0);
+            err = fabs(t - tref) * 86400;
+            if (err > maxerr) maxerr = err;
+            jd = tref + 1;
+        }
+    }
+    return maxerr;
+}
+
+/*  Evaluation time of a kernel in ns over n dates in jd[].  */
+static double kernel_time(moon_phase_fn kernel, const double *jd, long n)
+{
+    double t0, acc, p, a, d, ad, sd, sa;
+    long i;
+
+    acc = 0;
+    t0 = now();
+    for (i = 0; i < n; i++)
+        acc += kernel(jd[i], &p, &a, &d, &ad, &sd, &sa) + p + d;
+    sink = acc;
+    return (now() - t0) / n * 1e9;
+}
+
+static void bench_kernel(void)
+{
+    enum { N = 1000000 };
+    static double jd[N];
+    double p0, i0, a0, d0, ad0, sd0, sa0, p1, i1, a1, d1, ad1, sd1, sa1;
+    double dphase, dillum, ddist;
+    long i;
+
+    for (i = 0; i < N; i++) jd[i] = uniform(JD1900, JD2100);
+
+    dphase = dillum = ddist = 0;
+    for (i = 0; i < N; i++)
+    {
+        double e;
+        p0 = moon_phase_double(jd[i], &i0, &a0, &d0, &ad0, &sd0, &sa0);
+        p1 = moon_phase_float(jd[i], &i1, &a1, &d1, &ad1, &sd1, &sa1);
+        e = fabs(p1 - p0);
+        if (e > 0.5) e = 1 - e;
+        if (e > dphase) dphase = e;
+        if (fabs(i1 - i0) > dillum) dillum = fabs(i1 - i0);
+        if (fabs(d1 - d0) > ddist) ddist = fabs(d1 - d0);
+    }
+
+    printf("kernel: double %6.1f ns/eval\n", kernel_time(moon_phase_double, jd, N));
+    printf("kernel: float  %6.1f ns/eval, max deviation: phase %.2g, "
+           "illuminated %.2g, distance %.3g km, events %.2f s\n",
+           kernel_time(moon_phase_float, jd, N), dphase, dillum, ddist,
+           max_event_error(moon_phase_float, moon_phase_double));
+}
+
+/* -------------------------------------------------------------------- */
+/*  batch: structure-of-arrays evaluator against the scalar loop        */
+
+static void bench_batch(void)
+{
+    enum { N = 1000000 };
+    static double jd[N], out[2][7][N];
+    struct moon_batch b;
+    double t0, t1, t2, dphase, ddist, e;
+    long i;
+    int pass;
+
+    for (i = 0; i < N; i++) jd[i] = uniform(JD1900, JD2100);
+
+    b.phase = out[1][0]; b.illum = out[1][1]; b.age = out[1][2];
+    b.dist = out[1][3]; b.angdia = out[1][4]; b.sundist = out[1][5];
+    b.sunang = out[1][6];
+
+    /* second pass is the timed one */
+    for (pass = 0; pass < 2; pass++)
+    {
+        t0 = now();
+        for (i = 0; i < N; i++)
+            out[0][0][i] = moon_phase_double(jd[i], &out[0][1][i], &out[0][2][i],
+                &out[0][3][i], &out[0][4][i], &out[0][5][i], &out[0][6][i]);
+        t1 = now();
+        moon_phase_batch(jd, N, &b);
+        t2 = now();
+    }
+
+    dphase = ddist = 0;
+    for (i = 0; i < N; i++)
+    {
+        e = fabs(out[1][0][i] - out[0][0][i]);
+        if (e > 0.5) e = 1 - e;
+        if (e > dphase) dphase = e;
+        e = fabs(out[1][3][i] - out[0][3][i]);
+        if (e > ddist) ddist = e;
+    }
+    printf("batch: scalar %.3g evals/s, batch %.3g evals/s (x%.1f), "
+           "max deviation: phase %.2g, distance %.2g km\n",
+           N / (t1 - t0), N / (t2 - t1), (t1 - t0) / (t2 - t1), dphase, ddist);
+}
+
+/* -------------------------------------------------------------------- */
+/*  cheb: Chebyshev fitted ephemeris, accuracy and evaluation speed     */
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return x < y ? -1 : x > y;
+}
+
+static void bench_cheb(void)
+{
+    enum { N = 1000000 };
+    static const int orders[] = { 8, 10, 12, 14, 16 };
+    static double jd[N], sorted[N];
+    struct moon_cheb c;
+    double *coef, seglen = SYNMONTH / 2, t0, tfit, teval, trand, acc, e;
+    double p0, i0, a0, d0, ad0, sd0, sa0, p1, i1, d1, ad1;
+    double dphase, dillum, ddist;
+    int nseg, k;
+    long i;
+
+    for (i = 0; i < N; i++) sorted[i] = jd[i] = uniform(JD1900, JD2100);
+    qsort(sorted, N, sizeof(double), cmp_double);
+    nseg = (int) ((JD2100 - JD1900) / seglen) + 1;
+    coef = malloc(moon_cheb_size(nseg, 32) * sizeof(double));
+
+    printf("cheb: moon_phase() %.1f ns/eval\n", kernel_time(moon_phase, jd, N));
+    for (k = 0; k < (int) (sizeof(orders) / sizeof(orders[0])); k++)
+    {
+        t0 = now();
+        moon_cheb_fit(&c, moon_phase, JD1900, seglen, nseg, orders[k], coef);
+        tfit = now() - t0;
+
+        /* dates in order, as when sampling a range; random order mostly
+           measures cache misses on the table */
+        acc = 0;
+        t0 = now();
+        for (i = 0; i < N; i++)
+            acc += moon_cheb_eval(&c, sorted[i], &i1, &d1, &ad1) + i1 + d1;
+        teval = (now() - t0) / N * 1e9;
+        t0 = now();
+        for (i = 0; i < N; i++)
+            acc += moon_cheb_eval(&c, jd[i], &i1, &d1, &ad1) + i1 + d1;
+        trand = (now() - t0) / N * 1e9;
+        sink = acc;
+
+        dphase = dillum = ddist = 0;
+        for (i = 0; i < N; i++)
+        {
+            p0 = moon_phase(jd[i], &i0, &a0, &d0, &ad0, &sd0, &sa0);
+            p1 = moon_cheb_eval(&c, jd[i], &i1, &d1, &ad1);
+            e = fabs(p1 - p0);
+            if (e > 0.5) e = 1 - e;
+            if (e > dphase) dphase = e;
+            if (fabs(i1 - i0) > dillum) dillum = fabs(i1 - i0);
+            if (fabs(d1 - d0) > ddist) ddist = fabs(d1 - d0);
+        }
+        printf("cheb: order %2d, %4.0f KB for 1900-2100, fit %.0f ms, "
+               "%5.1f ns/eval (%5.1f random), max error: phase %.2g s, "
+               "illuminated %.2g, distance %.2g km\n", orders[k],
+               moon_cheb_size(nseg, orders[k]) * sizeof(double) / 1024.,
+               tfit * 1e3, teval, trand, dphase * SYNMONTH * 86400, dillum,
+               ddist);
+    }
+    free(coef);
+}
+
+/* -------------------------------------------------------------------- */
+/*  step: fixed-step recurrences, drift against direct evaluation       */
+
+static void bench_step(void)
+{
+    enum { N = 1000000 };
+    static const struct { double step; int resync; } runs[] = {
+        { 1. / 1440, 0 }, { 1. / 1440, 4096 },
+        { 1. / 24, 0 }, { 1. / 24, 4096 }, { 1, 0 },
+    };
+    struct moon_stepper st;
+    double p0, i0, a0, d0, ad0, sd0, sa0, p1, i1, a1, d1, ad1, sd1, sa1;
+    double t0, tstep, tdirect, acc, e, dphase, ddist, jd;
+    long i;
+    int k;
+
+    for (k = 0; k < (int) (sizeof(runs) / sizeof(runs[0])); k++)
+    {
+        acc = 0;
+        moon_step_init(&st, JD1900, runs[k].step, runs[k].resync);
+        t0 = now();
+        for (i = 0; i < N; i++)
+            acc += moon_step(&st, &i1, &a1, &d1, &ad1, &sd1, &sa1) + i1 + d1;
+        tstep = (now() - t0) / N * 1e9;
+        t0 = now();
+        for (i = 0; i < N; i++)
+            acc += moon_phase_double(JD1900 + i * runs[k].step,
+                                     &i0, &a0, &d0, &ad0, &sd0, &sa0) + i0 + d0;
+        tdirect = (now() - t0) / N * 1e9;
+        sink = acc;
+
+        dphase = ddist = 0;
+        moon_step_init(&st, JD1900, runs[k].step, runs[k].resync);
+        for (i = 0; i < N; i++)
+        {
+            jd = JD1900 + i * runs[k].step;
+            p0 = moon_phase_double(jd, &i0, &a0, &d0, &ad0, &sd0, &sa0);
+            p1 = moon_step(&st, &i1, &a1, &d1, &ad1, &sd1, &sa1);
+            e = fabs(p1 - p0);
+            if (e > 0.5) e = 1 - e;
+            if (e > dphase) dphase = e;
+            if (fabs(d1 - d0) > ddist) ddist = fabs(d1 - d0);
+        }
+        printf("step: %7.4f d x %d, resync %4d: %5.1f ns/sample (direct %5.1f), "
+               "max drift: phase %.2g s, distance %.2g km\n",
+               runs[k].step, N, runs[k].resync, tstep, tdirect,
+               dphase * SYNMONTH * 86400, ddist);
+    }
+}
+
+/* -------------------------------------------------------------------- */
+/*  elp: cost against accuracy of the ELP term count                    */
+
+/*  Largest and RMS difference in seconds between kernel's new and full
+    moons and Meeus's chapter 49 times, 1900-2100.  */
+static void meeus_event_error(moon_phase_fn kernel, double *maxerr, double *rms)
+{
+    long k, k0 = meeus_lunation(JD1900), k1 = meeus_lunation(JD2100);
+    double ref, t, e, sum = 0;
+    int kind, n = 0;
+
+    *maxerr = 0;
+    for (k = k0; k <= k1; k++)
+        for (kind = MEEUS_NEW; kind <= MEEUS_FULL; kind++)
+        {
+            ref = meeus_phase_jd(k, kind);
+            t = phase_search_with(kernel, ref - 3, kind == MEEUS_FULL ? 0.5 : 1.0);
+            e = fabs(t - ref) * 86400;
+            if (e > *maxerr) *maxerr = e;
+            sum += e * e;
+            n++;
+        }
+    *rms = sqrt(sum / n);
+}
+
+static void bench_elp(void)
+{
+    enum { N = 200000 };
+    static const int terms[] = { 0, 1, 2, 4, 8, 12, 16, 24, 32, 45, 60 };
+    static double jd[N];
+    double maxerr, rms;
+    long i;
+    int k;
+
+    for (i = 0; i < N; i++) jd[i] = uniform(JD1900, JD2100);
+
+    printf("elp: kernel          ns/eval   max error s   rms error s   "
+           "(events 1900-2100 against Meeus ch. 49)\n");
+    meeus_event_error(moon_phase_double, &maxerr, &rms);
+    printf("elp: double         %8.1f  %12.1f  %12.1f\n",
+           kernel_time(moon_phase_double, jd, N), maxerr, rms);
+    meeus_event_error(moon_phase_float, &maxerr, &rms);
+    printf("elp: float          %8.1f  %12.1f  %12.1f\n",
+           kernel_time(moon_phase_float, jd, N), maxerr, rms);
+    for (k = 0; k < (int) (sizeof(terms) / sizeof(terms[0])); k++)
+    {
+        moon_elp_terms = terms[k];
+        meeus_event_error(moon_phase_elp, &maxerr, &rms);
+        printf("elp: elp %2d terms   %8.1f  %12.1f  %12.1f\n", terms[k],
+               kernel_time(moon_phase_elp, jd, N), maxerr, rms);
+    }
+    moon_elp_terms = LUNA_ELP_TERMS;
+}
+
+/* -------------------------------------------------------------------- */
+/*  events: a century of perigees, apogees and supermoons               */
+
+#define SUPERMOON_KM 360000.        /* full moon closer than this */
+
+/*  Walker's distance is a fixed ellipse, never under 363297 km, so the
+    ELP kernel is used here.  */
+
+static void bench_events(void)
+{
+    enum { MAXEV = 2000 };
+    static struct moon_event ev[MAXEV];
+    static const struct { const char *name; int channel, kind; double level; } runs[] = {
+        { "perigee", EV_DIST, EV_MINIMUM, 0 },
+        { "apogee", EV_DIST, EV_MAXIMUM, 0 },
+        { "full moon", EV_PHASE, EV_RISING, 0.5 },
+        { "illum 50%", EV_ILLUM, EV_RISING, 0.5 },
+    };
+    struct moon_event_search s;
+    double jd0 = JD1900 + 36524, jd1 = jd0 + 36525;   /* 2000-2100 */
+    double t0, t, e, maxerr, near, illum, age, dist, angdia, sd, sa;
+    int k, i, n, super = 0, closest;
+
+    for (k = 0; k < (int) (sizeof(runs) / sizeof(runs[0])); k++)
+    {
+        moon_event_init(&s, moon_phase_elp, runs[k].channel);
+        t0 = now();
+        n = moon_event_scan(&s, runs[k].kind, runs[k].level, jd0, jd1, ev, MAXEV);
+        t = now() - t0;
+
+        /* extrema: the channel must not be lower (higher) a minute either
+           side; phase crossings: against phase_search_forward() */
+        maxerr = 0;
+        closest = 0;
+        for (i = 0; i < n; i++)
+        {
+            if (runs[k].channel == EV_PHASE)
+            {
+                e = fabs(phase_search_with(moon_phase_elp, ev[i].jd - 3,
+                                           runs[k].level) - ev[i].jd) * 86400;
+                if (e > maxerr) maxerr = e;
+                moon_phase_elp(ev[i].jd, &illum, &age, &dist, &angdia, &sd, &sa);
+                if (dist < SUPERMOON_KM) super++;
+            } else if (runs[k].kind != EV_RISING)
+            {
+                double sign = runs[k].kind == EV_MAXIMUM ? -1 : 1;
+                moon_phase_elp(ev[i].jd - 1. / 1440, &illum, &age, &near, &angdia, &sd, &sa);
+                if (sign * (near - ev[i].value) < 0) maxerr++;
+                moon_phase_elp(ev[i].jd + 1. / 1440, &illum, &age, &near, &angdia, &sd, &sa);
+                if (sign * (near - ev[i].value) < 0) maxerr++;
+                if (runs[k].kind == EV_MINIMUM && ev[i].value < ev[closest].value)
+                    closest = i;
+            }
+        }
+        printf("events: %-9s %5d in 2000-2100, %5.1f evals/event, %6.2f ms",
+               runs[k].name, n, (double) s.evaluations / n, t * 1e3);
+        if (runs[k].channel == EV_PHASE)
+            printf(", %.2g s from phase_search_with(), %d supermoons\n", maxerr, super);
+        else if (runs[k].kind != EV_RISING)
+            printf(", %g not extreme within a minute\n", maxerr);
+        else
+            printf("\n");
+        if (runs[k].kind == EV_MINIMUM)
+        {
+            struct tm tm = timej(ev[closest].jd);
+            printf("events: closest perigee %04d-%02d-%02d %02d:%02d, %.0f km\n",
+                   tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
+                   tm.tm_min, ev[closest].value);
+        }
+    }
+}
+
+/* -------------------------------------------------------------------- */
+/*  eclipse: a millennium of eclipses                                   */
+
+static void bench_eclipse(void)
+{
+    enum { MAXEV = 8000 };
+    static struct eclipse ev[MAXEV];
+    static const char *kind[] = { "solar", "lunar" };
+    static const char *type[] = { "penumbral", "partial", "total", "annular" };
+    struct eclipse_stats st;
+    double jd0 = days_from_civil(1500, 1, 1) + 2440587.5;
+    double jd1 = days_from_civil(2500, 1, 1) + 2440587.5;
+    double t0, t;
+    int count[2][4] = { { 0 } };
+    int i, n, k, j;
+
+    t0 = now();
+    n = eclipse_scan(jd0, jd1, ev, MAXEV, &st);
+    t = now() - t0;
+    for (i = 0; i < n; i++) count[ev[i].kind][ev[i].type]++;
+    printf("eclipse: 1500-2500 in %.1f ms, %lu of %lu syzygies searched\n",
+           t * 1e3, st.candidates, st.lunations);
+    for (k = 0; k < 2; k++)
+    {
+        printf("eclipse: %s", kind[k]);
+        for (j = 0; j < 4; j++)
+            if (count[k][j]) printf(" %d %s", count[k][j], type[j]);
+        printf("\n");
+    }
+
+    n = eclipse_scan(days_from_civil(2017, 1, 1) + 2440587.5,
+                     days_from_civil(2025, 1, 1) + 2440587.5, ev, MAXEV, NULL);
+    for (i = 0; i < n; i++)
+    {
+        struct tm tm = timej(ev[i].jd);
+        printf("eclipse: %04d-%02d-%02d %02d:%02d %s %-9s magnitude %.3f\n",
+               tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
+               kind[ev[i].kind], type[ev[i].type], ev[i].magnitude);
+    }
+}
+
+/* -------------------------------------------------------------------- */
+/*  rise: moonrise and moonset against dense direct sampling            */
+
+/*  Sine of the Moon's altitude less that of the standard altitude, from
+    a full moon_ecliptic() evaluation at jd.  */
+static double direct_altitude(const struct observer *o, double jd)
+{
+    struct moon_ecliptic e;
+    double eps, ra, dec, hp, lst, sl, cl, sb, cb;
+
+    moon_ecliptic(jd, &e);
+    eps = TORAD(23.439291 - 0.0130042 * (jd - 2451545.0) / 36525);
+    sl = dsin(e.lambda); cl = dcos(e.lambda);
+    sb = dsin(e.beta); cb = dcos(e.beta);
+    ra = TODEG(atan2(sl * cb * cos(eps) - sb * sin(eps), cl * cb));
+    dec = asin(sb * cos(eps) + cb * sin(eps) * sl);
+    hp = TODEG(asin(EARTHRAD / e.dist));
+    lst = 280.46061837 + 360.98564736629 * (jd - 2451545.0) + o->lon;
+    return dsin(o->lat) * sin(dec) + dcos(o->lat) * cos(dec) * dcos(lst - ra) -
+           dsin(0.7275 * hp - 0.5667);
+}
+
+/*  Largest difference in seconds between the rises and sets in days and
+    the crossings found by sampling direct_altitude() every minute.  */
+static double rise_error(const struct observer *o, double jd0, int ndays,
+                         const struct moon_day *days, int *missed, int *twice)
+{
+    double t, lo, hi, mid, flo, fhi, fmid, e, maxerr = 0, best;
+    int i, j, k;
+
+    *missed = *twice = 0;
+    flo = direct_altitude(o, jd0);
+    for (i = 0; i < ndays * 1440; i++)
+    {
+        lo = jd0 + i / 1440.;
+        hi = jd0 + (i + 1) / 1440.;
+        fhi = direct_altitude(o, hi);
+        if ((flo < 0) != (fhi < 0))
+        {
+            int rise = flo < 0;
+            double a = lo, b = hi, fa = flo;
+            for (k = 0; k < 30; k++)
+            {
+                mid = 0.5 * (a + b);
+                fmid = direct_altitude(o, mid);
+                if ((fmid < 0) == (fa < 0)) { a = mid; fa = fmid; } else b = mid;
+            }
+            t = 0.5 * (a + b);
+            j = (int) floor(t - jd0);
+            best = rise ? days[j].rise : days[j].set;
+            e = fabs(best - t) * 86400;
+            if (best < 0) (*missed)++;
+            else if (e > 600) (*twice)++;      /* a second one that day */
+            else if (e > maxerr) maxerr = e;
+        }
+        flo = fhi;
+    }
+    return maxerr;
+}
+
+static void bench_rise(void)
+{
+    enum { NDAY = 3653, NCHECK = 366 };
+    static struct moon_day days[NDAY];
+    static const struct { const char *name; struct observer o; } sites[] = {
+        { "Quito", { -0.18, -78.47 } },
+        { "Greenwich", { 51.48, 0 } },
+        { "Tromso", { 69.65, 18.96 } },
+    };
+    double jd0 = JD1900 + 36524 + 0.5;     /* 2000 January 1, 0h UT */
+    double t0, t, maxerr;
+    int k, i, nrise, missed, twice;
+
+    for (k = 0; k < (int) (sizeof(sites) / sizeof(sites[0])); k++)
+    {
+        t0 = now();
+        moon_riseset(&sites[k].o, jd0, NDAY, days);
+        t = (now() - t0) / NDAY;
+        for (i = nrise = 0; i < NDAY; i++) nrise += days[i].rise >= 0;
+        maxerr = rise_error(&sites[k].o, jd0, NCHECK, days, &missed, &twice);
+        printf("rise: %-9s %5.2f us/day, %4d rises in %d days; in %d days "
+               "max error %.1f s, %d missed, %d second in a day\n",
+               sites[k].name, t * 1e6, nrise, NDAY, NCHECK, maxerr, missed, twice);
+    }
+}
+
+/* -------------------------------------------------------------------- */
+/*  sky: a screen width of altitude and azimuth samples                 */
+
+static void bench_sky(void)
+{
+    enum { W = 320, NTRACK = 1000 };
+    static double alt[W], az[W];
+    static struct moon_day days[30];
+    const struct observer o = { 51.48, 0 };
+    struct moon_sky s;
+    double jd0 = JD1900 + 36524 + 0.5, t0, t, a, z, maxrise = 0, maxtransit = 0;
+    int i;
+
+    moon_sky_init(&s, &o);
+    t0 = now();
+    for (i = 0; i < NTRACK; i++)
+        moon_sky_track(&s, jd0 + i + 0.25, 1. / W, W, alt, az);
+    t = (now() - t0) / NTRACK;
+    sink = alt[W / 2] + az[W / 2];
+
+    /* the centre is at -(34' + semidiameter) at rise and set, and at the
+       transit altitude due south or north */
+    moon_riseset(&o, jd0, 30, days);
+    for (i = 0; i < 30; i++)
+    {
+        double sd = 0.2725 * TODEG(asin(EARTHRAD / 384400.));
+        if (days[i].rise >= 0)
+        {
+            moon_sky_altaz(&s, days[i].rise, &a, &z);
+            if (fabs(a + 0.5667 + sd) > maxrise) maxrise = fabs(a + 0.5667 + sd);
+        }
+        if (days[i].transit >= 0)
+        {
+            moon_sky_altaz(&s, days[i].transit, &a, &z);
+            if (fabs(a - days[i].transit_alt) > maxtransit)
+                maxtransit = fabs(a - days[i].transit_alt);
+            if (fabs(z - 180) > maxtransit) maxtransit = fabs(z - 180);
+        }
+    }
+    printf("sky: %d samples in %.1f us (%.0f ns/sample); against moon_riseset(): "
+           "rise altitude %.3f deg, transit %.3f deg\n",
+           W, t * 1e6, t / W * 1e9, maxrise, maxtransit);
+}
+
+/* -------------------------------------------------------------------- */
+/*  calendar: bulk conversion to the lunar calendars                    */
+
+/*  Next day's date is the day after, or the first of another month.  */
+static int date_follows(const struct lunar_date *a, const struct lunar_date *b)
+{
+    if (b->day == a->day + 1)
+        return b->month == a->month && b->leap == a->leap && b->year == a->year;
+    return b->day == 1 && a->day >= 29 && a->day <= 30 &&
+           (b->month != a->month || b->leap != a->leap);
+}
+
+static void bench_calendar(void)
+{
+    enum { N = 1000000, WINDOW = 4096 };
+    static struct newmoon buf[WINDOW];
+    static int64_t days[N];
+    struct newmoons t;
+    struct lunar_date d, prev[3];
+    int64_t day0 = days_from_civil(1900, 1, 1), day1 = days_from_civil(2100, 1, 1), day;
+    double t0, tcold, tisl, theb, tchi;
+    long i, bad[3] = { 0, 0, 0 };
+    int sum = 0;
+
+    for (i = 0; i < N; i++) days[i] = (int64_t) uniform(day0, day1);
+    newmoons_init(&t, buf, WINDOW, JD1900 + 36524);
+
+    t0 = now();
+    for (i = 0; i < N; i++) { chinese_from_days(&t, days[i], &d); sum += d.day; }
+    tcold = (now() - t0) / N;
+    t0 = now();
+    for (i = 0; i < N; i++) { islamic_from_days(&t, days[i], &d); sum += d.day; }
+    tisl = (now() - t0) / N;
+    t0 = now();
+    for (i = 0; i < N; i++) { hebrew_from_days(days[i], &d); sum += d.day; }
+    theb = (now() - t0) / N;
+    t0 = now();
+    for (i = 0; i < N; i++) { chinese_from_days(&t, days[i], &d); sum += d.day; }
+    tchi = (now() - t0) / N;
+    sink = sum;
+    printf("calendar: %d random dates 1900-2100, ns/date: islamic %.0f, hebrew %.0f, "
+           "chinese %.0f (%.0f filling the table, %lu new moon searches)\n",
+           N, tisl * 1e9, theb * 1e9, tchi * 1e9, tcold * 1e9, t.searches);
+
+    islamic_from_days(&t, day0 - 1, &prev[0]);
+    hebrew_from_days(day0 - 1, &prev[1]);
+    chinese_from_days(&t, day0 - 1, &prev[2]);
+    for (day = day0; day < day1; day++)
+    {
+        islamic_from_days(&t, day, &d);
+        bad[0] += !date_follows(&prev[0], &d);
+        prev[0] = d;
+        hebrew_from_days(day, &d);
+        bad[1] += !date_follows(&prev[1], &d) ||
+                  days_from_hebrew(d.year, d.month, d.day) != day;
+        prev[1] = d;
+        chinese_from_days(&t, day, &d);
+        bad[2] += !date_follows(&prev[2], &d);
+        prev[2] = d;
+    }
+    printf("calendar: every day 1900-2100: %ld islamic, %ld hebrew, %ld chinese "
+           "inconsistent dates\n", bad[0], bad[1], bad[2]);
+}
+
+/* -------------------------------------------------------------------- */
+
+static const struct {
+    const char *name;
+    void (*run)(void);
+} benches[] = {
+    { "time", bench_time },
+    { "cache", bench_cache },
+    { "kernel", bench_kernel },
+    { "batch", bench_batch },
+    { "cheb", bench_cheb },
+    { "step", bench_step },
+    { "elp", bench_elp },
+    { "events", bench_events },
+    { "eclipse", bench_eclipse },
+    { "rise", bench_rise },
+    { "sky", bench_sky },
+    { "calendar", bench_calendar },
+};
+
+#define NBENCH ((int) (sizeof(benches) / sizeof(benches[0])))
+
+int main(int argc, char *argv[])
+{
+    int i, j;
+
+    if (argc < 2)
+    {
+        for (i = 0; i < NBENCH; i++) benches[i].run();
+        return 0;
+    }
+    for (j = 1; j < argc; j++)
+    {
+        for (i = 0; i < NBENCH; i++)
+            if (strcmp(argv[j], benches[i].name) == 0) break;
+        if (i == NBENCH)
+        {
+            fprintf(stderr, "lunabench: unknown benchmark '%s'\n", argv[j]);
+            return 1;
+        }
+        benches[i].run();
+    }
+    return 0;
+}
@@ -0,0 +1,290 @@
+/*
+ * lunacheck - accuracy and speed regression check for the moon_phase()
+ *             kernels and the phase searches
+ *
+ * usage: lunacheck reference_file budget_file
+ *        lunacheck -g first_year last_year > reference_file
+ *
+ * The reference file lists new (N) and full (F) moons as Julian (UT)
+ * dates, one per line; '#' starts a comment.  It is generated with -g
+ * from Meeus's chapter 49 algorithm (tools/meeusphase.c), which does not
+ * share any code with the kernels.
+ *
+ * The budget file has one line per kernel: name, largest allowed error
+ * and largest allowed rms error, both in seconds, and optionally the
+ * name of another kernel whose event times the errors are then taken
+ * against instead of the reference file's.  The ELP kernel has a line
+ * per term count instead, as elp16, covering builds with that many terms
+ * up to the next line's count.  Each kernel the build
+ * can select is searched for every reference event, through
+ * phase_search_with() and, for moon_phase(), through
+ * phase_search_forward() and phase_search_cached() as well.  Errors and
+ * evaluations per second are printed, and the exit status is 1 if any
+ * budget is exceeded or a kernel has no budget.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "moontool.h"
+#include "meeusphase.h"
+
+struct event {
+    double jd;
+    double target;              /* 1.0 for new moon, 0.5 for full */
+};
+
+static const struct {
+    const char *name;
+    moon_phase_fn kernel;
+    const int *terms;           /* periodic terms summed, if a knob */
+} kernels[] = {
+    { "double", moon_phase_double, NULL },
+    { "float", moon_phase_float, NULL },
+    { "elp", moon_phase_elp, &moon_elp_terms },
+};
+
+#define NKERNEL ((int) (sizeof(kernels) / sizeof(kernels[0])))
+
+/* search entry points checked for moon_phase() as built */
+#define SEARCH_WITH     0
+#define SEARCH_FORWARD  1
+#define SEARCH_CACHED   2
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static int generate(int y0, int y1)
+{
+    struct tm t = { .tm_mday = 1 };
+    double jd0, jd1, jd;
+    long k;
+    int kind;
+
+    t.tm_year = y0 - 1900;
+    jd0 = jtime(&t);
+    t.tm_year = y1 + 1 - 1900;
+    jd1 = jtime(&t);
+    printf("# New (N) and full (F) moons %d-%d, Julian date UT,\n"
+           "# from Meeus, Astronomical Algorithms, ch. 49 (lunacheck -g)\n",
+           y0, y1);
+    for (k = meeus_lunation(jd0) - 1; k <= meeus_lunation(jd1) + 1; k++)
+        for (kind = MEEUS_NEW; kind <= MEEUS_FULL; kind++)
+        {
+            jd = meeus_phase_jd(k, kind);
+            if (jd >= jd0 && jd < jd1)
+                printf("%c %.6f\n", kind == MEEUS_NEW ? 'N' : 'F', jd);
+        }
+    return 0;
+}
+
+static struct event *read_events(const char *path, int *n)
+{
+    FILE *f = fopen(path, "r");
+    struct event *ev = NULL;
+    char line[128], kind;
+    double jd;
+    int cap = 0;
+
+    *n = 0;
+    if (!f) return NULL;
+    while (fgets(line, sizeof(line), f))
+    {
+        if (line[0] == '#' || sscanf(line, " %c %lf", &kind, &jd) != 2) continue;
+        if (*n == cap)
+        {
+            cap = cap ? 2 * cap : 1024;
+            ev = realloc(ev, cap * sizeof(*ev));
+            if (!ev) break;
+        }
+        ev[*n].jd = jd;
+        ev[(*n)++].target = kind == 'F' ? 0.5 : 1.0;
+    }
+    fclose(f);
+    return ev;
+}
+
+/*  Budget for kernel name, and in against the kernel it is measured
+    against, or "" for the reference file; returns 0 if the budget file
+    has none.  For a kernel that sums terms periodic terms (-1 if it has
+    no such knob) the rows are named for a term count, as elp16, and the
+    one with the most terms not above terms applies.  */
+static int read_budget(const char *path, const char *name, int terms,
+                       double *maxerr, double *rms, char against[32])
+{
+    FILE *f = fopen(path, "r");
+    char line[128], kname[32], kagainst[32], *end;
+    size_t len = strlen(name);
+    double kmax, krms;
+    long n;
+    int best = -1;
+
+    if (!f) return 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        if (line[0] == '#') continue;
+        kagainst[0] = 0;
+        if (sscanf(line, "%31s %lf %lf %31s", kname, &kmax, &krms, kagainst) < 3 ||
+            strncmp(kname, name, len) != 0)
+            continue;
+        if (terms < 0)
+        {
+            if (kname[len]) continue;
+            n = 0;
+        }
+        else
+        {
+            n = strtol(kname + len, &end, 10);
+            if (end == kname + len || *end || n > terms || n <= best) continue;
+        }
+        best = (int) n;
+        *maxerr = kmax;
+        *rms = krms;
+        strcpy(against, kagainst);
+        if (terms < 0) break;
+    }
+    fclose(f);
+    return best >= 0;
+}
+
+/*  The events as found by kernel, for budgets against another kernel;
+    NULL if a search fails.  */
+static struct event *kernel_events(moon_phase_fn kernel, const struct event *ev, int n)
+{
+    struct event *kev = malloc(n * sizeof(*kev));
+    int i;
+
+    for (i = 0; kev && i < n; i++)
+    {
+        kev[i].target = ev[i].target;
+        kev[i].jd = phase_search_with(kernel, ev[i].jd - 3, ev[i].target);
+        if (kev[i].jd < 0)
+        {
+            free(kev);
+            return NULL;
+        }
+    }
+    return kev;
+}
+
+/*  Search all events from three days before each; returns 0 on success
+    and fills in the errors and speed.  */
+static int check(moon_phase_fn kernel, int how, const struct event *ev, int n,
+                 double *maxerr, double *rms, double *evals_per_s)
+{
+    unsigned long evals0 = phase_search_stats()->evaluations;
+    double t0, t, e, sum = 0;
+    int i;
+
+    *maxerr = 0;
+    t0 = now();
+    for (i = 0; i < n; i++)
+    {
+        double start = ev[i].jd - 3;
+        t = how == SEARCH_CACHED ? phase_search_cached(start, ev[i].target) :
+            how == SEARCH_FORWARD ? phase_search_forward(start, ev[i].target) :
+            phase_search_with(kernel, start, ev[i].target);
+        if (t < 0) return -1;
+        e = fabs(t - ev[i].jd) * 86400;
+        if (e > *maxerr) *maxerr = e;
+        sum += e * e;
+    }
+    t = now() - t0;
+    *rms = sqrt(sum / n);
+    *evals_per_s = (phase_search_stats()->evaluations - evals0) / t;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *how_name[] = { "", " (phase_search_forward)",
+                                      " (phase_search_cached)" };
+    struct event *ev, *ref;
+    double maxerr, rms, speed, bmax, brms;
+    char against[32];
+    int n, k, r, how, fail = 0;
+
+    if (argc == 4 && strcmp(argv[1], "-g") == 0)
+        return generate(atoi(argv[2]), atoi(argv[3]));
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: lunacheck reference_file budget_file\n"
+                        "       lunacheck -g first_year last_year\n");
+        return 2;
+    }
+    ev = read_events(argv[1], &n);
+    if (!ev || n == 0)
+    {
+        fprintf(stderr, "lunacheck: cannot read events from %s\n", argv[1]);
+        return 2;
+    }
+    printf("lunacheck: %d reference events\n", n);
+    printf("%-40s %10s %10s %12s\n", "kernel", "max s", "rms s", "evals/s");
+
+    for (k = 0; k < NKERNEL; k++)
+    {
+        int selected = k == LUNA_KERNEL;
+        int terms = kernels[k].terms ? *kernels[k].terms : -1;
+        char name[40];
+
+        if (terms >= 0)
+            snprintf(name, sizeof(name), "%s%d", kernels[k].name, terms);
+        else
+            snprintf(name, sizeof(name), "%s", kernels[k].name);
+        if (!read_budget(argv[2], kernels[k].name, terms, &bmax, &brms, against))
+        {
+            printf("%-40s no budget in %s\n", name, argv[2]);
+            fail = 1;
+            continue;
+        }
+        ref = ev;
+        if (against[0])
+        {
+            for (r = 0; r < NKERNEL && strcmp(kernels[r].name, against) != 0; r++)
+                ;
+            ref = r < NKERNEL ? kernel_events(kernels[r].kernel, ev, n) : NULL;
+            if (!ref)
+            {
+                printf("%-40s no events from %s to measure against\n",
+                       name, against);
+                fail = 1;
+                continue;
+            }
+        }
+        for (how = SEARCH_WITH; how <= (selected ? SEARCH_CACHED : SEARCH_WITH); how++)
+        {
+            char label[112];
+            int ok;
+
+            snprintf(label, sizeof(label), "%s%s%s%s", name, how_name[how],
+                     against[0] ? " - " : "", against);
+            if (check(kernels[k].kernel, how, ref, n, &maxerr, &rms, &speed))
+            {
+                printf("%-40s search failed\n", label);
+                fail = 1;
+                continue;
+            }
+            ok = maxerr <= bmax && rms <= brms;
+            printf("%-40s %10.1f %10.1f %12.3g  %s\n", label, maxerr, rms, speed,
+                   ok ? "ok" : "OVER BUDGET");
+            if (!ok) fail = 1;
+        }
+        if (ref != ev) free(ref);
+    }
+    free(ev);
+    return fail;
+}
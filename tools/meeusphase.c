@@ -0,0 +1,120 @@
+/*
+ * meeusphase - new and full moon times after Jean Meeus, "Astronomical
+ * Algorithms" (2nd ed.), chapter 49.
+ *
+ * An algorithm independent of the kernels in moontool.c, stated to be
+ * good to a few seconds over several centuries; the host tools use it as
+ * the reference for event times.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include "moonconst.h"
+#include "moontool.h"
+#include "meeusphase.h"
+
+/*  Periodic corrections: coefficient for new and full moon, power of E,
+    and multiples of M, M', F and Omega in the argument.  */
+static const struct {
+    double cnew, cfull;
+    int epow;
+    signed char m, mp, f, om;
+} corr[] = {
+    { -0.40720, -0.40614, 0,  0,  1,  0, 0 },
+    {  0.17241,  0.17302, 1,  1,  0,  0, 0 },
+    {  0.01608,  0.01614, 0,  0,  2,  0, 0 },
+    {  0.01039,  0.01043, 0,  0,  0,  2, 0 },
+    {  0.00739,  0.00734, 1, -1,  1,  0, 0 },
+    { -0.00514, -0.00515, 1,  1,  1,  0, 0 },
+    {  0.00208,  0.00209, 2,  2,  0,  0, 0 },
+    { -0.00111, -0.00111, 0,  0,  1, -2, 0 },
+    { -0.00057, -0.00057, 0,  0,  1,  2, 0 },
+    {  0.00056,  0.00056, 1,  1,  2,  0, 0 },
+    { -0.00042, -0.00042, 0,  0,  3,  0, 0 },
+    {  0.00042,  0.00042, 1,  1,  0,  2, 0 },
+    {  0.00038,  0.00038, 1,  1,  0, -2, 0 },
+    { -0.00024, -0.00024, 1, -1,  2,  0, 0 },
+    { -0.00017, -0.00017, 0,  0,  0,  0, 1 },
+    { -0.00007, -0.00007, 0,  2,  1,  0, 0 },
+    {  0.00004,  0.00004, 0,  0,  2, -2, 0 },
+    {  0.00004,  0.00004, 0,  3,  0,  0, 0 },
+    {  0.00003,  0.00003, 0,  1,  1, -2, 0 },
+    {  0.00003,  0.00003, 0,  0,  2,  2, 0 },
+    { -0.00003, -0.00003, 0,  1,  1,  2, 0 },
+    {  0.00003,  0.00003, 0, -1,  1,  2, 0 },
+    { -0.00002, -0.00002, 0, -1,  1, -2, 0 },
+    { -0.00002, -0.00002, 0,  1,  3,  0, 0 },
+    {  0.00002,  0.00002, 0,  0,  4,  0, 0 },
+};
+
+/*  Additional planetary corrections, 1e-6 day, with A = a0 + a1 * k.  */
+static const struct {
+    int c;
+    double a0, a1;
+} planet[] = {
+    { 325, 299.77, 0.107408 }, { 165, 251.88, 0.016321 },
+    { 164, 251.83, 26.651886 }, { 126, 349.42, 36.412478 },
+    { 110,  84.66, 18.206239 }, {  62, 141.74, 53.303771 },
+    {  60, 207.14, 2.453732 },  {  56, 154.84, 7.306860 },
+    {  47,  34.52, 27.261239 }, {  42, 207.19, 0.121824 },
+    {  40, 291.34, 1.844379 },  {  37, 161.72, 24.198154 },
+    {  35, 239.56, 25.513099 }, {  23, 331.55, 3.592518 },
+};
+
+#define NCORR   ((int) (sizeof(corr) / sizeof(corr[0])))
+#define NPLANET ((int) (sizeof(planet) / sizeof(planet[0])))
+
+/*  MEEUS_PHASE_JDE  --  Julian Ephemeris Day (TD) of the new or full moon
+        of lunation k, counted from the new moon of 2000 January 6.  */
+double meeus_phase_jde(long k, int kind)
+{
+    double kk = k + (kind == MEEUS_FULL ? 0.5 : 0), T, jde, E, M, Mp, F, Om,
+           a, sum;
+    int i;
+
+    T = kk / 1236.85;
+    jde = 2451550.09766 + 29.530588861 * kk + T * T * (0.00015437 +
+          T * (-0.000000150 + T * 0.00000000073));
+    E = 1 - T * (0.002516 + T * 0.0000074);
+    M = 2.5534 + 29.10535670 * kk - T * T * (0.0000014 + T * 0.00000011);
+    Mp = 201.5643 + 385.81693528 * kk + T * T * (0.0107582 +
+         T * (0.00001238 - T * 0.000000058));
+    F = 160.7108 + 390.67050284 * kk - T * T * (0.0016118 +
+        T * (0.00000227 - T * 0.000000011));
+    Om = 124.7746 - 1.56375588 * kk + T * T * (0.0020672 + T * 0.00000215);
+
+    sum = 0;
+    for (i = 0; i < NCORR; i++)
+    {
+        a = corr[i].m * M + corr[i].mp * Mp + corr[i].f * F + corr[i].om * Om;
+        sum += (kind == MEEUS_FULL ? corr[i].cfull : corr[i].cnew) *
+               (corr[i].epow == 0 ? 1 : corr[i].epow == 1 ? E : E * E) *
+               dsin(FIXANGLE(a));
+    }
+    for (i = 0; i < NPLANET; i++)
+    {
+        a = planet[i].a0 + planet[i].a1 * kk;
+        if (i == 0) a -= 0.009173 * T * T;
+        sum += planet[i].c * 1e-6 * dsin(FIXANGLE(a));
+    }
+    return jde + sum;
+}
+
+/*  MEEUS_PHASE_JD  --  The same event as a Julian (UT) date.  */
+double meeus_phase_jd(long k, int kind)
+{
+    double jde = meeus_phase_jde(k, kind);
+    return jde - delta_t(jde) / 86400;
+}
+
+/*  MEEUS_LUNATION  --  Lunation whose new moon is nearest to jd.  */
+long meeus_lunation(double jd)
+{
+    return lround((jd - 2451550.09766) / 29.530588861);
+}
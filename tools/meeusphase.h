@@ -0,0 +1,15 @@
+/*
+ * meeusphase - mean and true new/full moon times after Meeus, chapter 49
+ */
+
+#ifndef MEEUSPHASE_H
+#define MEEUSPHASE_H
+
+#define MEEUS_NEW   0
+#define MEEUS_FULL  1
+
+double meeus_phase_jde(long k, int kind);
+double meeus_phase_jd(long k, int kind);
+long meeus_lunation(double jd);
+
+#endif
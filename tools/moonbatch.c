@@ -0,0 +1,259 @@
+/*
+ * moonbatch - moon_phase() over arrays of dates, structure-of-arrays output
+ *
+ * The same theory as moon_phase_double(), evaluated a block of dates at a
+ * time.  Every stage is a plain loop over arrays with no branches or libm
+ * calls, which the compiler vectorises; sines and cosines go through
+ * sin_turn_array(), which has explicit SSE2/AVX versions on x86.  Angles
+ * are kept in turns so range reduction is a rounding, not a division.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+
+#include <math.h>
+#include "moonconst.h"
+#include "moonbatch.h"
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define BLOCK 256                   /* dates per block, fits in L1 */
+
+/*  Round to nearest integer by adding and removing 1.5 * 2^52; exact for
+    |x| < 2^51 and vectorises without SSE4.1.  */
+#define ROUNDER 6755399441055744.0
+
+static inline double round_d(double x)
+{
+    return (x + ROUNDER) - ROUNDER;
+}
+
+/*  Taylor coefficients of sin and cos in x = 2 pi r for |r| <= 1/8
+    turn; the first omitted terms are below 5e-17.  */
+#define S3  (-1.0 / 6)
+#define S5  (1.0 / 120)
+#define S7  (-1.0 / 5040)
+#define S9  (1.0 / 362880)
+#define S11 (-1.0 / 39916800)
+#define S13 (1.0 / 6227020800.0)
+#define S15 (-1.0 / 1307674368000.0)
+#define C2  (-1.0 / 2)
+#define C4  (1.0 / 24)
+#define C6  (-1.0 / 720)
+#define C8  (1.0 / 40320)
+#define C10 (-1.0 / 3628800)
+#define C12 (1.0 / 479001600)
+#define C14 (-1.0 / 87178291200.0)
+#define C16 (1.0 / 20922789888000.0)
+
+/*  Portable version, also used for loop tails.  The quadrant q of t is
+    folded in arithmetically so the loop stays branch free.  */
+static inline double sin_turn_d(double t)
+{
+    double q, q4, neg, odd, x, x2, s, c;
+
+    q = round_d(4 * t);                     /* nearest quarter turn */
+    x = 2 * PI * (t - 0.25 * q);            /* |x| <= pi/4 */
+    q4 = q - 4 * round_d(0.25 * q - 0.375); /* q mod 4 */
+    neg = round_d(0.5 * q4 - 0.25);         /* quadrants 2 and 3 */
+    odd = q4 - 2 * neg;                     /* quadrants 1 and 3 */
+    x2 = x * x;
+    s = x + x * x2 * (S3 + x2 * (S5 + x2 * (S7 + x2 * (S9 + x2 * (S11 +
+            x2 * (S13 + x2 * S15))))));
+    c = 1 + x2 * (C2 + x2 * (C4 + x2 * (C6 + x2 * (C8 + x2 * (C10 +
+            x2 * (C12 + x2 * (C14 + x2 * C16)))))));
+    return (s + odd * (c - s)) * (1 - 2 * neg);
+}
+
+#if defined(__AVX__)
+
+#define VN 4
+typedef __m256d vdouble;
+#define vset1       _mm256_set1_pd
+#define vload       _mm256_loadu_pd
+#define vstore      _mm256_storeu_pd
+#define vadd        _mm256_add_pd
+#define vsub        _mm256_sub_pd
+#define vmul        _mm256_mul_pd
+#define vround(x)   _mm256_round_pd((x), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+#define vblend(a, b, mask)  _mm256_blendv_pd((a), (b), (mask))
+#define vge(a, b)   _mm256_cmp_pd((a), (b), _CMP_GE_OQ)
+#define vxor        _mm256_xor_pd
+#define vand        _mm256_and_pd
+
+#elif defined(__SSE2__)
+
+#define VN 2
+typedef __m128d vdouble;
+#define vset1       _mm_set1_pd
+#define vload       _mm_loadu_pd
+#define vstore      _mm_storeu_pd
+#define vadd        _mm_add_pd
+#define vsub        _mm_sub_pd
+#define vmul        _mm_mul_pd
+#define vround(x)   _mm_sub_pd(_mm_add_pd((x), vset1(ROUNDER)), vset1(ROUNDER))
+#define vblend(a, b, mask)  _mm_or_pd(_mm_andnot_pd((mask), (a)), _mm_and_pd((mask), (b)))
+#define vge(a, b)   _mm_cmpge_pd((a), (b))
+#define vxor        _mm_xor_pd
+#define vand        _mm_and_pd
+
+#endif
+
+#ifdef VN
+
+/*  Explicit vector version of sin_turn_d().  */
+static inline vdouble vsin_turn(vdouble t)
+{
+    vdouble q, q4, x, x2, s, c, r, odd, neg;
+
+    q = vround(vmul(t, vset1(4.0)));
+    x = vmul(vset1(2 * PI), vsub(t, vmul(q, vset1(0.25))));
+    q4 = vsub(q, vmul(vset1(4.0), vround(vsub(vmul(q, vset1(0.25)), vset1(0.375)))));
+    x2 = vmul(x, x);
+    s = vadd(vmul(x2, vset1(S15)), vset1(S13));
+    s = vadd(vmul(x2, s), vset1(S11));
+    s = vadd(vmul(x2, s), vset1(S9));
+    s = vadd(vmul(x2, s), vset1(S7));
+    s = vadd(vmul(x2, s), vset1(S5));
+    s = vadd(vmul(x2, s), vset1(S3));
+    s = vadd(vmul(vmul(x, x2), s), x);
+    c = vadd(vmul(x2, vset1(C16)), vset1(C14));
+    c = vadd(vmul(x2, c), vset1(C12));
+    c = vadd(vmul(x2, c), vset1(C10));
+    c = vadd(vmul(x2, c), vset1(C8));
+    c = vadd(vmul(x2, c), vset1(C6));
+    c = vadd(vmul(x2, c), vset1(C4));
+    c = vadd(vmul(x2, c), vset1(C2));
+    c = vadd(vmul(x2, c), vset1(1.0));
+    /* quadrants 1 and 3 take the cosine, 2 and 3 change sign */
+    odd = vsub(q4, vmul(vset1(2.0), vround(vsub(vmul(q4, vset1(0.5)), vset1(0.25)))));
+    r = vblend(s, c, vge(odd, vset1(0.5)));
+    neg = vand(vge(q4, vset1(2.0)), vset1(-0.0));
+    return vxor(r, neg);
+}
+
+#endif
+
+void sin_turn_array(const double *t, double *out, size_t n)
+{
+    size_t i = 0;
+
+#ifdef VN
+    for (; i + VN <= n; i += VN)
+        vstore(out + i, vsin_turn(vload(t + i)));
+#endif
+    for (; i < n; i++)
+        out[i] = sin_turn_d(t[i]);
+}
+
+void cos_turn_array(const double *t, double *out, size_t n)
+{
+    size_t i = 0;
+
+#ifdef VN
+    for (; i + VN <= n; i += VN)
+        vstore(out + i, vsin_turn(vadd(vload(t + i), vset1(0.25))));
+#endif
+    for (; i < n; i++)
+        out[i] = sin_turn_d(t[i] + 0.25);
+}
+
+/*  One block of at most BLOCK dates.  */
+static void batch_block(const double *jd, size_t n, const struct moon_batch *out,
+                        size_t off)
+{
+    const double e = ECCENT, k = 1 / (2 * PI);
+    double M[BLOCK], lambda[BLOCK], ml[BLOCK], MM[BLOCK], F[BLOCK],
+           s1[BLOCK], s2[BLOCK], s3[BLOCK], a[BLOCK], b[BLOCK];
+    size_t i;
+
+    /* Sun: mean anomaly, equation of centre, longitude; all in turns */
+    for (i = 0; i < n; i++)
+    {
+        double day = jd[i] - EPOCH;
+        M[i] = day * (1 / 365.2422) + (ELONGE - ELONGP) / 360;
+        M[i] -= round_d(M[i]);
+        ml[i] = day * (13.1763966 / 360) + MMLONG / 360;
+        ml[i] -= round_d(ml[i]);
+        MM[i] = ml[i] - day * (0.1114041 / 360) - MMLONGP / 360;
+        a[i] = 2 * M[i];
+        b[i] = 3 * M[i];
+    }
+    sin_turn_array(M, s1, n);
+    sin_turn_array(a, s2, n);
+    sin_turn_array(b, s3, n);
+    for (i = 0; i < n; i++)
+        lambda[i] = M[i] + k * (2 * e * s1[i] + 1.25 * e * e * s2[i] +
+                                e * e * e * s3[i]);        /* Ec */
+    cos_turn_array(lambda, a, n);
+    for (i = 0; i < n; i++)
+    {
+        F[i] = (1 + e * a[i]) / (1 - e * e);
+        lambda[i] += ELONGP / 360;
+        a[i] = 2 * (ml[i] - lambda[i]) - MM[i];
+    }
+
+    /* Moon: evection, annual equation, equation of centre */
+    sin_turn_array(a, s2, n);
+    for (i = 0; i < n; i++)
+    {
+        double Ev = (1.2739 / 360) * s2[i], Ae = (0.1858 / 360) * s1[i],
+               A3 = (0.37 / 360) * s1[i];
+        MM[i] += Ev - Ae - A3;                              /* MmP */
+        ml[i] += Ev - Ae;
+    }
+    sin_turn_array(MM, s3, n);
+    cos_turn_array(MM, a, n);
+    for (i = 0; i < n; i++)
+    {
+        double mEc = (6.2886 / 360) * s3[i], A4 = (0.214 / 360) * 2 * s3[i] * a[i];
+        ml[i] += mEc + A4;                                  /* lP */
+        MM[i] += mEc;                                       /* MmP + mEc */
+        a[i] = 2 * (ml[i] - lambda[i]);
+    }
+    sin_turn_array(a, s2, n);
+    for (i = 0; i < n; i++)
+    {
+        double age = ml[i] + (0.6583 / 360) * s2[i] - lambda[i];
+        age -= round_d(age - 0.5);                          /* to [0, 1) */
+        a[i] = age;
+    }
+    cos_turn_array(a, s1, n);
+    cos_turn_array(MM, s3, n);
+
+    for (i = 0; i < n; i++)
+        s3[i] = (MSMAX * (1 - MECC * MECC)) / (1 + MECC * s3[i]);  /* distance */
+
+    /* separate loops, so each one stays a straight vector copy */
+    if (out->phase)
+        for (i = 0; i < n; i++) out->phase[off + i] = a[i];
+    if (out->illum)
+        for (i = 0; i < n; i++) out->illum[off + i] = (1 - s1[i]) / 2;
+    if (out->age)
+        for (i = 0; i < n; i++) out->age[off + i] = SYNMONTH * a[i];
+    if (out->dist)
+        for (i = 0; i < n; i++) out->dist[off + i] = s3[i];
+    if (out->angdia)
+        for (i = 0; i < n; i++) out->angdia[off + i] = MANGSIZ * MSMAX / s3[i];
+    if (out->sundist)
+        for (i = 0; i < n; i++) out->sundist[off + i] = SUNSMAX / F[i];
+    if (out->sunang)
+        for (i = 0; i < n; i++) out->sunang[off + i] = F[i] * SUNANGSIZ;
+}
+
+/*  MOON_PHASE_BATCH  --  moon_phase_double() for jd[0..n-1], results in
+        the arrays of *out.  */
+void moon_phase_batch(const double *jd, size_t n, const struct moon_batch *out)
+{
+    size_t i, m;
+
+    for (i = 0; i < n; i += m)
+    {
+        m = n - i < BLOCK ? n - i : BLOCK;
+        batch_block(jd + i, m, out, i);
+    }
+}
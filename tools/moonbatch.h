@@ -0,0 +1,28 @@
+/*
+ * moonbatch - moon_phase() over arrays of dates, structure-of-arrays output
+ */
+
+#ifndef MOONBATCH_H
+#define MOONBATCH_H
+
+#include <stddef.h>
+
+/*  Output arrays, one element per input date.  Any pointer may be NULL
+    if that quantity is not wanted.  */
+struct moon_batch {
+    double *phase;              /* terminator phase angle, 0 to 1 */
+    double *illum;              /* illuminated fraction */
+    double *age;                /* age of the Moon in days */
+    double *dist;               /* distance in kilometres */
+    double *angdia;             /* angular diameter in degrees */
+    double *sundist;            /* distance to the Sun in kilometres */
+    double *sunang;             /* Sun's angular diameter in degrees */
+};
+
+void moon_phase_batch(const double *jd, size_t n, const struct moon_batch *out);
+
+/*  sin(2 pi t[i]) and cos(2 pi t[i]) for angles in turns.  */
+void sin_turn_array(const double *t, double *out, size_t n);
+void cos_turn_array(const double *t, double *out, size_t n);
+
+#endif